@@ -0,0 +1,218 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  ensemble.cpp
+ *
+ *    Description:  Monte Carlo ensemble of rigid bodies with randomly
+ *    perturbed initial angular velocity.  Trajectories are reduced on the
+ *    fly into per-frame statistics (ensemblestats.hpp), one shard per
+ *    thread, merged once all bodies have been integrated.
+ *
+ * =====================================================================================
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "ensemblestats.hpp"
+#include "rigidbodycore.hpp"
+
+using namespace rigidbody;
+
+struct Options {
+  Parameters p;
+  State x0 = {0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0};
+  double tf = 20.0, fps = 60.0, sigma = 0.01;
+  long bodies = 1000, threads = 0;
+  unsigned seed = 0;
+};
+
+// Integrate one body and feed every output frame to stats.  A body counts as
+// flipped once the angular velocity component about the axis it was
+// initially spinning fastest about has reversed sign.
+static int runBody(const Options & o, const State & x0,
+                   const std::vector<State> & nominal, EnsembleStats & stats)
+{
+  Integrator<7> rk(Model(o.p), dormandPrince54, 1e-6, 0.0);
+  State x = x0;
+  double t = 0.0, h = 1e-3;
+  std::size_t axis = 4;
+  for (std::size_t i = 5; i < 7; ++i)
+    if (magnitude(x0[i]) > magnitude(x0[axis]))
+      axis = i;
+  bool flipped = false;
+
+  for (std::size_t k = 0; k < stats.size(); ++k) {
+    if (k > 0 && rk.advance(t, k / o.fps, h, x) != Success)
+      return Failure;
+    flipped = flipped || x[axis]*x0[axis] < 0.0;
+    stats.observe(k, nominal[k], x, flipped);
+  }
+  return Success;
+} // runBody()
+
+int main(int argc, char ** argv)
+{
+  Options o;
+  int c, opt_index;
+  struct option long_options[] = {
+     {"help", no_argument, 0, '?'},
+     {"Ixx",  required_argument, 0, 'a'},
+     {"Iyy",  required_argument, 0, 'b'},
+     {"Izz",  required_argument, 0, 'c'},
+     {"Ixy",  required_argument, 0, 'd'},
+     {"Iyz",  required_argument, 0, 'e'},
+     {"Ixz",  required_argument, 0, 'f'},
+     {"wx",  required_argument, 0, 'g'},
+     {"wy",  required_argument, 0, 'h'},
+     {"wz",  required_argument, 0, 'i'},
+     {"tf",  required_argument, 0, 't'},
+     {"fps",  required_argument, 0, 'r'},
+     {"bodies",  required_argument, 0, 'n'},
+     {"sigma",  required_argument, 0, 's'},
+     {"threads",  required_argument, 0, 'j'},
+     {"seed",  required_argument, 0, 'z'},
+     {0, 0, 0, 0} };
+  while (1) {
+    opt_index = 0;
+    c = getopt_long(argc, argv, "?a:b:c:d:e:f:g:h:i:t:r:n:s:j:z:", long_options, &opt_index);
+
+  if (c == -1)
+    break;
+
+  switch (c) {
+    case '?':
+      printf(
+"usage: %s [OPTION]\n\n"
+"  -?, --help                   Display this help and exit.\n"
+"  --Ixx=val                    Ixx moment of inertia.\n"
+"  --Iyy=val                    Iyy moment of inertia.\n"
+"  --Izz=val                    Izz moment of inertia.\n"
+"  --Ixy=val                    Ixy product of inertia.\n"
+"  --Iyz=val                    yz product of inertia.\n"
+"  --Ixz=val                    Ixz product of inertia.\n"
+"  --wx=val                     Nominal initial angular velocity about body-fixed x axis\n"
+"  --wy=val                     Nominal initial angular velocity about body-fixed y axis\n"
+"  --wz=val                     Nominal initial angular velocity about body-fixed z axis\n"
+"  -t val, --tf=val             Total simulation time\n"
+"  --fps=val                    Output points per unit time\n"
+"  -n val, --bodies=val         Number of bodies in the ensemble\n"
+"  --sigma=val                  Standard deviation of initial angular velocity perturbation\n"
+"  -j val, --threads=val        Number of threads, at least 1, default all cores\n"
+"  --seed=val                   Random seed\n\n"
+"Prints one line per output point:\n"
+"  t flipped err_x err_y err_z sd_x sd_y sd_z\n"
+"    wx_05 wx_50 wx_95 wy_05 wy_50 wy_95 wz_05 wz_50 wz_95 e0 e1 e2 e3\n"
+"where flipped is the fraction of bodies that have flipped, err and sd the\n"
+"mean and standard deviation of attitude error from the nominal body, w?_XX\n"
+"quantiles of the angular velocity about each body-fixed axis, and e the mean\n"
+"orientation.\n\n"
+"Example of the intermediate axis effect:\n\n"
+"$ %s --Ixx=1.0 --Iyy=2.0 --Izz=3.0 --wy=2.0 --bodies=100000\n\n",
+             argv[0], argv[0]);
+      exit(0);
+
+    case 'a': o.p.Ixx = atof(optarg); break;
+    case 'b': o.p.Iyy = atof(optarg); break;
+    case 'c': o.p.Izz = atof(optarg); break;
+    case 'd': o.p.Ixy = atof(optarg); break;
+    case 'e': o.p.Iyz = atof(optarg); break;
+    case 'f': o.p.Ixz = atof(optarg); break;
+    case 'g': o.x0[4] = atof(optarg); break;
+    case 'h': o.x0[5] = atof(optarg); break;
+    case 'i': o.x0[6] = atof(optarg); break;
+    case 't': o.tf = atof(optarg); break;
+    case 'r': o.fps = atof(optarg); break;
+    case 'n': o.bodies = atol(optarg); break;
+    case 's': o.sigma = atof(optarg); break;
+    case 'j':
+      o.threads = atol(optarg);
+      if (o.threads < 1) {
+        fprintf(stderr, "%s: --threads must be at least 1\n", argv[0]);
+        return 1;
+      }
+      break;
+    case 'z': o.seed = atoi(optarg); break;
+    default: abort();
+    } // switch(c)
+  } // while
+
+  if (o.bodies < 1) {
+    fprintf(stderr, "%s: --bodies must be at least 1\n", argv[0]);
+    return 1;
+  }
+  if (o.threads == 0)
+    o.threads = std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1;
+  if (o.threads > o.bodies)
+    o.threads = o.bodies;
+  const std::size_t frames = (std::size_t) (o.fps * o.tf) + 1;
+
+  // Nominal trajectory, the reference for attitude error
+  std::vector<State> nominal(frames);
+  {
+    Integrator<7> rk(Model(o.p), dormandPrince54, 1e-6, 0.0);
+    State x = o.x0;
+    double t = 0.0, h = 1e-3;
+    nominal[0] = x;
+    for (std::size_t k = 1; k < frames; ++k) {
+      if (rk.advance(t, k / o.fps, h, x) != Success) {
+        fprintf(stderr, "integration of nominal body failed at t = %g\n", t);
+        return 1;
+      }
+      nominal[k] = x;
+    }
+  }
+
+  // Each body gets its own random stream so results don't depend on how
+  // bodies are distributed among threads
+  std::vector<EnsembleStats> shards(o.threads, EnsembleStats(frames));
+  std::vector<int> status(o.threads, Success);
+  std::vector<std::thread> workers;
+  for (long j = 0; j < o.threads; ++j)
+    workers.emplace_back([&, j] {
+      for (long b = j; b < o.bodies; b += o.threads) {
+        std::mt19937_64 rng(((unsigned long long) o.seed << 32) ^ (unsigned long long) b);
+        std::normal_distribution<double> dw(0.0, o.sigma);
+        State x0 = o.x0;
+        for (std::size_t i = 4; i < 7; ++i)
+          x0[i] += dw(rng);
+        if (runBody(o, x0, nominal, shards[j]) != Success)
+          status[j] = Failure;
+      }
+    });
+  for (std::thread & w : workers)
+    w.join();
+
+  for (long j = 1; j < o.threads; ++j) {
+    shards[0].merge(shards[j]);
+    if (status[j] != Success)
+      status[0] = Failure;
+  }
+  if (status[0] != Success)
+    fprintf(stderr, "integration failed for some bodies\n");
+
+  const EnsembleStats & stats = shards[0];
+  for (std::size_t k = 0; k < stats.size(); ++k) {
+    const FrameStats & f = stats[k];
+    const std::array<double, 4> q = f.orientation.mean();
+    printf("%.6f %.6f %+.6e %+.6e %+.6e %.6e %.6e %.6e",
+           k / o.fps, f.flipped / f.error.n,
+           f.error.mean[0], f.error.mean[1], f.error.mean[2],
+           squareRoot(f.error.covariance(0, 0)),
+           squareRoot(f.error.covariance(1, 1)),
+           squareRoot(f.error.covariance(2, 2)));
+    // The sketches hold deviations from the nominal rates
+    for (std::size_t i = 0; i < 3; ++i)
+      printf(" %+.6f %+.6f %+.6f", nominal[k][4 + i] + f.rate[i].quantile(0.05),
+             nominal[k][4 + i] + f.rate[i].quantile(0.5),
+             nominal[k][4 + i] + f.rate[i].quantile(0.95));
+    printf(" %+.9f %+.9f %+.9f %+.9f\n", q[0], q[1], q[2], q[3]);
+  }
+  return status[0] == Success ? 0 : 1;
+}
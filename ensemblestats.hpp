@@ -0,0 +1,311 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  ensemblestats.hpp
+ *
+ *    Description:  Streaming, mergeable statistics for Monte Carlo ensembles
+ *    of rigid bodies.  Each output frame keeps running moments, quantile
+ *    sketches, an accumulated quaternion mean and a flip count, so
+ *    trajectories never have to be stored.  Shards collected by
+ *    different threads are combined with merge().
+ *
+ * =====================================================================================
+ */
+
+#ifndef  ENSEMBLESTATS_HPP
+#define  ENSEMBLESTATS_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "rigidbodycore.hpp"
+
+namespace rigidbody {
+
+// Running mean and covariance of an N vector (Welford), merged with the
+// pairwise update of Chan et al.
+template <std::size_t N>
+struct Moments {
+  double n = 0.0;
+  std::array<double, N> mean{};
+  // Sum of outer products of deviations from the mean
+  std::array<std::array<double, N>, N> m2{};
+
+  constexpr void add(const std::array<double, N> & x) noexcept
+  {
+    std::array<double, N> d{};
+    n += 1.0;
+    for (std::size_t i = 0; i < N; ++i) {
+      d[i] = x[i] - mean[i];
+      mean[i] += d[i]/n;
+    }
+    for (std::size_t i = 0; i < N; ++i)
+      for (std::size_t j = 0; j < N; ++j)
+        m2[i][j] += d[i]*(x[j] - mean[j]);
+  } // add()
+
+  constexpr void merge(const Moments & o) noexcept
+  {
+    if (o.n == 0.0)
+      return;
+    const double n0 = n, nt = n + o.n;
+    std::array<double, N> d{};
+    for (std::size_t i = 0; i < N; ++i) {
+      d[i] = o.mean[i] - mean[i];
+      mean[i] += d[i]*o.n/nt;
+    }
+    for (std::size_t i = 0; i < N; ++i)
+      for (std::size_t j = 0; j < N; ++j)
+        m2[i][j] += o.m2[i][j] + d[i]*d[j]*n0*o.n/nt;
+    n = nt;
+  } // merge()
+
+  // Unbiased sample covariance
+  constexpr double covariance(std::size_t i, std::size_t j) const noexcept
+  {
+    return n > 1.0 ? m2[i][j]/(n - 1.0) : 0.0;
+  }
+};
+
+// Quantile sketch (merging t-digest, Dunning and Ertl).  Values are kept as
+// at most Compression + 2 weighted centroids, sized by the k1 scale function
+// so they hold few values near the tails and more near the median: the rank
+// error at quantile q is a small multiple of sqrt(q (1 - q))/Compression,
+// independent of how wide or narrow the distribution is.  New values are
+// buffered and folded in a sorted pass once the buffer fills.  Sketches
+// merge with the same pass.
+template <std::size_t Compression>
+struct QuantileSketch {
+  static constexpr std::size_t Capacity = Compression + 2;
+  double n = 0.0, lo = 0.0, hi = 0.0;
+  std::size_t centroids = 0, buffered = 0;
+  std::array<double, Capacity> mean{}, weight{}, buffer{};
+
+  void add(double x) noexcept
+  {
+    if (buffered == Capacity)
+      compress(nullptr);
+    if (n == 0.0 || x < lo)
+      lo = x;
+    if (n == 0.0 || x > hi)
+      hi = x;
+    buffer[buffered++] = x;
+    n += 1.0;
+  } // add()
+
+  void merge(const QuantileSketch & o) noexcept
+  {
+    if (o.n == 0.0)
+      return;
+    lo = n == 0.0 || o.lo < lo ? o.lo : lo;
+    hi = n == 0.0 || o.hi > hi ? o.hi : hi;
+    n += o.n;
+    compress(&o);
+  } // merge()
+
+  // Fold the buffer, and the centroids and buffer of o if given, into the
+  // centroids.  Consecutive values are combined while the centroid stays
+  // within one unit of k(q) = Compression/(2 pi) asin(2 q - 1), so any two
+  // neighbours span more than one unit and there are at most
+  // Compression + 1 of them.
+  void compress(const QuantileSketch * o) noexcept
+  {
+    std::array<std::pair<double, double>, 4*Capacity> v;
+    std::size_t m = 0;
+    for (std::size_t i = 0; i < centroids; ++i)
+      v[m++] = {mean[i], weight[i]};
+    for (std::size_t i = 0; i < buffered; ++i)
+      v[m++] = {buffer[i], 1.0};
+    if (o) {
+      for (std::size_t i = 0; i < o->centroids; ++i)
+        v[m++] = {o->mean[i], o->weight[i]};
+      for (std::size_t i = 0; i < o->buffered; ++i)
+        v[m++] = {o->buffer[i], 1.0};
+    }
+    std::sort(v.begin(), v.begin() + m);
+
+    const double scale = Compression/(2.0*M_PI);
+    double q0 = 0.0, limit = qLimit(q0, scale);
+    std::pair<double, double> c = v[0];
+    centroids = buffered = 0;
+    for (std::size_t i = 1; i < m; ++i) {
+      if (q0 + (c.second + v[i].second)/n <= limit) {
+        c.second += v[i].second;
+        c.first += (v[i].first - c.first)*v[i].second/c.second;
+      } else {
+        q0 += c.second/n;
+        limit = qLimit(q0, scale);
+        mean[centroids] = c.first;
+        weight[centroids++] = c.second;
+        c = v[i];
+      }
+    }
+    mean[centroids] = c.first;
+    weight[centroids++] = c.second;
+  } // compress()
+
+  // Largest q reachable from q0 within one unit of k
+  static double qLimit(double q0, double scale) noexcept
+  {
+    const double k = std::asin(2.0*q0 - 1.0)*scale + 1.0;
+    return k < 0.25*Compression ? 0.5*(std::sin(k/scale) + 1.0) : 1.0;
+  }
+
+  // q-quantile, interpolating linearly between centroids, and between the
+  // outer centroids and the smallest and largest values
+  double quantile(double q) const noexcept
+  {
+    if (buffered) {
+      QuantileSketch s = *this;
+      s.compress(nullptr);
+      return s.quantile(q);
+    }
+    if (n == 0.0)
+      return 0.0;
+    const double r = q*n;
+    double below = 0.0, x = lo, at = 0.0;
+    for (std::size_t i = 0; i < centroids; ++i) {
+      const double mid = below + 0.5*weight[i];
+      if (r < mid)
+        return x + (mean[i] - x)*(r - at)/(mid - at);
+      x = mean[i];
+      at = mid;
+      below += weight[i];
+    }
+    return n > at ? x + (hi - x)*(r - at)/(n - at) : hi;
+  } // quantile()
+};
+
+// Mean orientation as the dominant eigenvector of the accumulated matrix
+// sum(q q^T) (Markley et al.), insensitive to the sign ambiguity of q.
+struct QuaternionMean {
+  std::array<std::array<double, 4>, 4> M{};
+
+  constexpr void add(const State & x) noexcept
+  {
+    for (std::size_t i = 0; i < 4; ++i)
+      for (std::size_t j = 0; j < 4; ++j)
+        M[i][j] += x[i]*x[j];
+  }
+
+  constexpr void merge(const QuaternionMean & o) noexcept
+  {
+    for (std::size_t i = 0; i < 4; ++i)
+      for (std::size_t j = 0; j < 4; ++j)
+        M[i][j] += o.M[i][j];
+  }
+
+  // Power iteration, M is positive semi-definite so the largest eigenvalue
+  // dominates.  Returned with non-negative scalar part e3.
+  constexpr std::array<double, 4> mean() const noexcept
+  {
+    std::array<double, 4> q = {M[0][0], M[1][1], M[2][2], M[3][3]};
+    std::size_t k = 0;
+    for (std::size_t i = 1; i < 4; ++i)
+      if (q[i] > q[k])
+        k = i;
+    q = M[k];
+    for (int it = 0; it < 100; ++it) {
+      std::array<double, 4> r{};
+      double s = 0.0;
+      for (std::size_t i = 0; i < 4; ++i) {
+        for (std::size_t j = 0; j < 4; ++j)
+          r[i] += M[i][j]*q[j];
+        s += r[i]*r[i];
+      }
+      if (s == 0.0)
+        return {0.0, 0.0, 0.0, 1.0};
+      s = 1.0/squareRoot(s);
+      for (std::size_t i = 0; i < 4; ++i)
+        q[i] = r[i]*s;
+    }
+    if (q[3] < 0.0)
+      for (std::size_t i = 0; i < 4; ++i)
+        q[i] = -q[i];
+    return q;
+  } // mean()
+};
+
+// Rotation vector taking the nominal orientation xn to the orientation of
+// x, expressed in the nominal body frame.  e3 is the scalar part of the
+// Euler parameters; the error quaternion is taken with non-negative scalar
+// part so the angle lies in [0, pi].
+inline std::array<double, 3> attitudeError(const State & xn, const State & x) noexcept
+{
+  double s = xn[3]*x[3] + xn[0]*x[0] + xn[1]*x[1] + xn[2]*x[2];
+  double v[3] = {
+    xn[3]*x[0] - xn[0]*x[3] - xn[1]*x[2] + xn[2]*x[1],
+    xn[3]*x[1] - xn[1]*x[3] - xn[2]*x[0] + xn[0]*x[2],
+    xn[3]*x[2] - xn[2]*x[3] - xn[0]*x[1] + xn[1]*x[0]
+  };
+  if (s < 0.0) {
+    s = -s;
+    v[0] = -v[0];
+    v[1] = -v[1];
+    v[2] = -v[2];
+  }
+  const double vn = std::sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+  // angle/|v|, which tends to 2/s for small angles
+  const double scale = vn > 1e-8 ? 2.0*std::atan2(vn, s)/vn : 2.0/s;
+  return {scale*v[0], scale*v[1], scale*v[2]};
+} // attitudeError()
+
+// Everything kept for one output frame
+struct FrameStats {
+  static constexpr std::size_t Compression = 300;
+  Moments<3> error;
+  // Deviation of angular velocity from the nominal body
+  std::array<QuantileSketch<Compression>, 3> rate;
+  QuaternionMean orientation;
+  double flipped = 0.0;
+
+  constexpr void merge(const FrameStats & o) noexcept
+  {
+    error.merge(o.error);
+    for (std::size_t i = 0; i < 3; ++i)
+      rate[i].merge(o.rate[i]);
+    orientation.merge(o.orientation);
+    flipped += o.flipped;
+  }
+};
+
+// Statistics of a whole ensemble, one FrameStats per output frame.  Memory
+// is fixed by the number of frames, not the number of bodies.
+class EnsembleStats {
+ public:
+  explicit EnsembleStats(std::size_t frames) : frames_(frames) { }
+
+  std::size_t size() const noexcept { return frames_.size(); }
+  const FrameStats & operator[](std::size_t k) const noexcept { return frames_[k]; }
+
+  // Record the state x of one body at frame k, along with the nominal state
+  // xn at the same time and whether this body has flipped
+  void observe(std::size_t k, const State & xn, const State & x, bool flipped) noexcept
+  {
+    FrameStats & f = frames_[k];
+    f.error.add(attitudeError(xn, x));
+    for (std::size_t i = 0; i < 3; ++i)
+      f.rate[i].add(x[4 + i] - xn[4 + i]);
+    f.orientation.add(x);
+    if (flipped)
+      f.flipped += 1.0;
+  } // observe()
+
+  // Shards must have the same number of frames
+  void merge(const EnsembleStats & o) noexcept
+  {
+    for (std::size_t k = 0; k < frames_.size(); ++k)
+      frames_[k].merge(o.frames_[k]);
+  }
+
+ private:
+  std::vector<FrameStats> frames_;
+};
+
+} // namespace rigidbody
+
+#endif   /* ----- #ifndef ENSEMBLESTATS_HPP ----- */
@@ -0,0 +1,810 @@
+#!/usr/bin/env python3
+# =====================================================================================
+#
+#       Filename:  genkernels.py
+#
+#    Description:  Generates rigidbodykernels.hpp, the equations of motion,
+#    linearization (A and B) and 4x4 transformation matrix (m) of the rigid
+#    body described in rigidbody.al, as C++ kernels.  Expressions are built as
+#    a hash-consed DAG, so identical subexpressions are shared and evaluated
+#    once; subexpressions that depend only on the constants, including the
+#    reciprocal of the mass matrix determinant, are hoisted into a separate
+#    kernel evaluated once per parameter set.  Op counts of the generated
+#    kernels, and of the same expressions without sharing, are reported.
+#
+#    Usage:  genkernels.py rigidbody.al > rigidbodykernels.hpp
+#
+#    Only the subset of Autolev used by rigidbody.al is understood: a single
+#    body in a Newtonian frame oriented with Euler parameters (dircos and
+#    kindiffs with euler), its angular velocity given as a linear function of
+#    the motion variables, inertia, an applied torque, and the states, B and
+#    m definitions.  The kinematic equations and direction cosines come from
+#    the kindiffs and dircos statements.  Any statement or option outside
+#    this subset, such as another orientation type, translational motion or
+#    an applied force, is an error rather than being silently ignored.
+#
+# =====================================================================================
+
+import re
+import sys
+from collections import Counter
+from fractions import Fraction
+
+# ---------------------------------------------------------------------------
+# Expression DAG.  Every node is unique (hash-consed), so structurally equal
+# subexpressions are the same object.  Kinds:
+#   ('num', v)                    rational constant
+#   ('sym', name)                 state or constant
+#   ('lin', c0, ((c, n), ...))    c0 + sum of c*n
+#   ('mul', (n, ...))             product, no numeric factor
+#   ('inv', n)                    1/n
+
+class Node(object):
+    __slots__ = ('key', 'id', 'free')
+
+    def __init__(self, key, id, free):
+        self.key, self.id, self.free = key, id, free
+
+    kind = property(lambda self: self.key[0])
+
+_table = {}
+
+def _node(key, free):
+    n = _table.get(key)
+    if n is None:
+        n = _table[key] = Node(key, len(_table), free)
+    return n
+
+def num(v):
+    return _node(('num', Fraction(v)), frozenset())
+
+def sym(name):
+    return _node(('sym', name), frozenset([name]))
+
+ZERO, ONE = num(0), num(1)
+
+def _lin(c0, terms):
+    terms = tuple(sorted(terms, key=lambda t: t[1].id))
+    free = frozenset().union(*[n.free for c, n in terms])
+    return _node(('lin', c0, terms), free)
+
+def _mul(factors):
+    factors = tuple(sorted(factors, key=lambda n: n.id))
+    return _node(('mul', factors), frozenset().union(*[n.free for n in factors]))
+
+def _split(x):
+    """Numeric coefficient and remaining node of x."""
+    if x.kind == 'num':
+        return x.key[1], ONE
+    if x.kind == 'lin' and x.key[1] == 0 and len(x.key[2]) == 1:
+        return x.key[2][0]
+    return Fraction(1), x
+
+def add(*xs):
+    c0, acc = Fraction(0), {}
+    for x in xs:
+        if x.kind == 'num':
+            c0 += x.key[1]
+            continue
+        terms = [(x.key[1], ONE)] + list(x.key[2]) if x.kind == 'lin' else [(Fraction(1), x)]
+        for c, n in terms:
+            if n is ONE:
+                c0 += c
+            else:
+                acc[n] = acc.get(n, 0) + c
+    terms = [(c, n) for n, c in acc.items() if c != 0]
+    if not terms:
+        return num(c0)
+    if c0 == 0 and len(terms) == 1 and terms[0][0] == 1:
+        return terms[0][1]
+    return _lin(c0, terms)
+
+def mul(*xs):
+    coef, factors = Fraction(1), []
+    for x in xs:
+        c, n = _split(x)
+        coef *= c
+        if n.kind == 'mul':
+            factors.extend(n.key[1])
+        elif n is not ONE:
+            factors.append(n)
+    if coef == 0:
+        return ZERO
+    if not factors:
+        return num(coef)
+    n = factors[0] if len(factors) == 1 else _mul(factors)
+    return n if coef == 1 else _lin(Fraction(0), [(coef, n)])
+
+def inv(x):
+    c, n = _split(x)
+    if n is ONE:
+        return num(1 / c)
+    if n.kind == 'inv':
+        return mul(num(1 / c), n.key[1])
+    return mul(num(1 / c), _node(('inv', n), n.free))
+
+def neg(x):
+    return mul(num(-1), x)
+
+def sub(a, b):
+    return add(a, neg(b))
+
+_dcache = {}
+
+def diff(x, s):
+    """Partial derivative of x with respect to the symbol named s."""
+    if s not in x.free:
+        return ZERO
+    k = (x.id, s)
+    if k not in _dcache:
+        kind = x.kind
+        if kind == 'sym':
+            d = ONE
+        elif kind == 'lin':
+            d = add(*[mul(num(c), diff(n, s)) for c, n in x.key[2]])
+        elif kind == 'mul':
+            f = x.key[1]
+            d = add(*[mul(*(f[:i] + (diff(f[i], s),) + f[i + 1:])) for i in range(len(f))])
+        else:
+            d = neg(mul(x, x, diff(x.key[1], s)))
+        _dcache[k] = d
+    return _dcache[k]
+
+# ---------------------------------------------------------------------------
+# Parser for the right hand side of Autolev assignments
+
+def parse_expr(text, names):
+    token = r'\d+\.?\d*(?:[eE][-+]?\d+)?|\w+|[-+*/^()]'
+    if re.sub(token, '', text).strip():
+        raise SystemExit('genkernels.py: cannot parse expression %s' % text.strip())
+    tokens = re.findall(token, text)
+    pos = [0]
+
+    def peek():
+        return tokens[pos[0]] if pos[0] < len(tokens) else None
+
+    def take():
+        if pos[0] == len(tokens):
+            raise SystemExit('genkernels.py: cannot parse expression %s' % text.strip())
+        pos[0] += 1
+        return tokens[pos[0] - 1]
+
+    def atom():
+        t = take()
+        if t == '(':
+            e = expr()
+            if take() != ')':
+                raise SystemExit('genkernels.py: cannot parse expression %s' % text.strip())
+            return e
+        if t == '-':
+            return neg(atom())
+        if re.match(r'\d', t):
+            return num(Fraction(t))
+        if t not in names:
+            raise SystemExit('genkernels.py: unknown symbol %s' % t)
+        return names[t]
+
+    def power():
+        b = atom()
+        if peek() == '^':
+            take()
+            t = take()
+            sign = -1 if t == '-' else 1
+            if sign < 0:
+                t = take()
+            if not t.isdigit():
+                raise SystemExit('genkernels.py: only integer powers are supported in %s'
+                                 % text.strip())
+            e = sign*int(t)
+            return mul(*([b] * e)) if e >= 0 else inv(mul(*([b] * -e)))
+        return b
+
+    def term():
+        e = power()
+        while peek() in ('*', '/'):
+            e = mul(e, power()) if take() == '*' else mul(e, inv(power()))
+        return e
+
+    def expr():
+        e = term()
+        while peek() in ('+', '-'):
+            e = add(e, term()) if take() == '+' else sub(e, term())
+        return e
+
+    e = expr()
+    if peek() is not None:
+        raise SystemExit('genkernels.py: cannot parse expression %s' % text.strip())
+    return e
+
+def expand_names(text):
+    """'e0, e{3}' -> ['e0', 'e1', 'e2', 'e3'], primes dropped."""
+    out = []
+    for item in text.replace("'", '').split(','):
+        item = item.strip()
+        m = re.match(r'(\w+)\{(\d+)\}$', item)
+        if m:
+            out.extend('%s%d' % (m.group(1), i) for i in range(1, int(m.group(2)) + 1))
+        elif item:
+            out.append(item)
+    return out
+
+def split_top(text, sep):
+    """Split text at sep outside of parentheses and brackets."""
+    out, depth, start = [], 0, 0
+    for i, ch in enumerate(text):
+        depth += ch in '([' and 1 or ch in ')]' and -1 or 0
+        if ch == sep and depth == 0:
+            out.append(text[start:i].strip())
+            start = i + 1
+    out.append(text[start:].strip())
+    return out
+
+def vector(text, frame, names):
+    """Measure numbers of a vector written as sum of c*frame1> ... terms."""
+    comps = []
+    for i in (1, 2, 3):
+        sub_text = re.sub(r'\b%s%d>' % (frame, i), '1', text, flags=re.I)
+        for j in (1, 2, 3):
+            if j != i:
+                sub_text = re.sub(r'\b%s%d>' % (frame, j), '0', sub_text, flags=re.I)
+        comps.append(parse_expr(sub_text, names))
+    return comps
+
+def det3(M):
+    return add(mul(M[0][0], sub(mul(M[1][1], M[2][2]), mul(M[1][2], M[2][1]))),
+               neg(mul(M[0][1], sub(mul(M[1][0], M[2][2]), mul(M[1][2], M[2][0])))),
+               mul(M[0][2], sub(mul(M[1][0], M[2][1]), mul(M[1][1], M[2][0]))))
+
+def adj3(M):
+    def cof(i, j):
+        r = [k for k in range(3) if k != i]
+        c = [k for k in range(3) if k != j]
+        d = sub(mul(M[r[0]][c[0]], M[r[1]][c[1]]), mul(M[r[0]][c[1]], M[r[1]][c[0]]))
+        return d if (i + j) % 2 == 0 else neg(d)
+    return [[cof(j, i) for j in range(3)] for i in range(3)]
+
+def euler_dircos(e):
+    """Direction cosine matrix N_A from Euler parameters, e[3] the scalar part."""
+    e0, e1, e2, e3 = e
+    two = num(2)
+    return [[sub(ONE, mul(two, add(mul(e1, e1), mul(e2, e2)))),
+             mul(two, sub(mul(e0, e1), mul(e2, e3))),
+             mul(two, add(mul(e0, e2), mul(e1, e3)))],
+            [mul(two, add(mul(e0, e1), mul(e2, e3))),
+             sub(ONE, mul(two, add(mul(e0, e0), mul(e2, e2)))),
+             mul(two, sub(mul(e1, e2), mul(e0, e3)))],
+            [mul(two, sub(mul(e0, e2), mul(e1, e3))),
+             mul(two, add(mul(e0, e3), mul(e1, e2))),
+             sub(ONE, mul(two, add(mul(e0, e0), mul(e1, e1))))]]
+
+def cross(a, b):
+    return [sub(mul(a[1], b[2]), mul(a[2], b[1])),
+            sub(mul(a[2], b[0]), mul(a[0], b[2])),
+            sub(mul(a[0], b[1]), mul(a[1], b[0]))]
+
+def euler_kindiffs(e, w):
+    """Time derivatives of the Euler parameters e, e[3] the scalar part, for
+    angular velocity w expressed in the body frame."""
+    ev, e3 = e[:3], e[3]
+    half = num(Fraction(1, 2))
+    exw = cross(ev, w)
+    qdot = [mul(half, add(mul(e3, w[i]), exw[i])) for i in range(3)]
+    qdot.append(neg(mul(half, add(*[mul(ev[i], w[i]) for i in range(3)]))))
+    return qdot
+
+def model(path):
+    """Build f, A, B and m from the Autolev file.  Every statement is checked
+    against what the kernels assume, and anything not understood is an error
+    rather than silently left out."""
+    text = open(path).read()
+    lines = [re.sub(r'%.*', '', l).strip() for l in text.splitlines()]
+    where = ['']
+
+    def fail(msg):
+        raise SystemExit('genkernels.py: %s: %s' % (where[0], msg))
+
+    def declared(text, what):
+        """Names of a declaration, each with exactly one prime."""
+        items = [t.strip() for t in text.split(',')]
+        if not all(re.match(r"\w+(\{\d+\})?'$", t) for t in items):
+            fail('only first order %s are supported' % what)
+        return expand_names(text)
+
+    def expr(text):
+        if "'" in text or '>' in text:
+            fail('cannot interpret %s' % text.strip())
+        return parse_expr(text, names)
+
+    def same(a, b):
+        return a.lower() == b.lower()
+
+    def frames(n, b):
+        if not (N and body):
+            fail('newtonian and body must be declared first')
+        if not (same(n, N) and same(b, body)):
+            fail('only body %s in newtonian frame %s is supported' % (body, N))
+
+    def euler(kind, args):
+        if kind.lower() != 'euler':
+            fail('only euler orientations are supported, not %s' % kind)
+        e = expand_names(args)
+        if e != qs:
+            fail('the Euler parameters must be the variables %s' % ', '.join(qs))
+        return [names[n] for n in e]
+
+    N = body = None
+    constants, qs, us, names = [], [], [], {}
+    I = w = e = qdot = NA = states = f = m = None
+    T = [ZERO, ZERO, ZERO]
+    rest, solved, linearized = set(), False, False
+    inputs, Bform = [], []
+
+    # Products are ordered by when their factors were first seen, so create
+    # the constants first to keep them leading in the generated code
+    for l in lines:
+        g = re.match(r'constants\s+(.*)$', l, re.I)
+        if g:
+            for n in expand_names(g.group(1)):
+                sym(n)
+
+    for lineno, l in enumerate(lines, 1):
+        where[0] = '%s:%d' % (path, lineno)
+        if not l:
+            continue
+        match = lambda pattern: re.match(pattern + r'$', l, re.I)
+        try:
+            if match(r'autoz\s+(on|off)') or match(r'unitsystem\s+\w+(\s*,\s*\w+)*') or \
+               match(r'code\s+dynamics\(\)\s+\S+'):
+                # Only affect the code Autolev itself writes
+                pass
+            elif match(r'autorhs\s+on'):
+                pass
+            elif match(r'newtonian\s+(\w+)'):
+                if N:
+                    fail('only one newtonian frame is supported')
+                N = match(r'newtonian\s+(\w+)').group(1)
+            elif match(r'(?:body|bodies)\s+(\w+)'):
+                if body:
+                    fail('only one body is supported')
+                body = match(r'(?:body|bodies)\s+(\w+)').group(1)
+            elif match(r'constants\s+(.*)'):
+                items = [t.strip() for t in match(r'constants\s+(.*)').group(1).split(',')]
+                if not all(re.match(r'\w+(\{\d+\})?$', t) for t in items):
+                    fail('only plain constants are supported')
+                constants.extend(expand_names(','.join(items)))
+            elif match(r'variables?\s+(.*)'):
+                if qs:
+                    fail('only one variables declaration is supported')
+                qs = declared(match(r'variables?\s+(.*)').group(1), 'variables')
+            elif match(r"motionvariables?'\s+(.*)"):
+                if us:
+                    fail('only one motionvariables declaration is supported')
+                us = declared(match(r"motionvariables?'\s+(.*)").group(1), 'motion variables')
+                if len(us) != 3:
+                    fail('there must be three motion variables')
+            elif match(r'mass\s+(\w+)\s*=(.*)'):
+                # The mass of a body that does not translate does not enter the
+                # equations, but must still be a valid expression
+                g = match(r'mass\s+(\w+)\s*=(.*)')
+                frames(N, g.group(1))
+                expr(g.group(2))
+            elif match(r'inertia\s+(\w+)\s*,(.*)'):
+                g = match(r'inertia\s+(\w+)\s*,(.*)')
+                frames(N, g.group(1))
+                terms = [expr(t) for t in g.group(2).split(',')]
+                if len(terms) not in (3, 6):
+                    fail('inertia needs three moments and optionally three products')
+                I11, I22, I33, I12, I23, I31 = (terms + [ZERO] * 3)[:6]
+                I = [[I11, I12, I31], [I12, I22, I23], [I31, I23, I33]]
+            elif match(r'dircos\(\s*(\w+)\s*,\s*(\w+)\s*,\s*(\w+)\s*,(.*)\)'):
+                g = match(r'dircos\(\s*(\w+)\s*,\s*(\w+)\s*,\s*(\w+)\s*,(.*)\)')
+                frames(g.group(1), g.group(2))
+                e = euler(g.group(3), g.group(4))
+                NA = euler_dircos(e)
+            elif match(r'w_(\w+)_(\w+)>\s*=(.*)'):
+                g = match(r'w_(\w+)_(\w+)>\s*=(.*)')
+                frames(g.group(2), g.group(1))
+                w = vector(g.group(3), body, names)
+            elif match(r'([va])_(\w+)_(\w+)>\s*=(.*)'):
+                g = match(r'([va])_(\w+)_(\w+)>\s*=(.*)')
+                if not (same(g.group(2), body + 'o') and same(g.group(3), N)):
+                    fail('cannot interpret %s' % l)
+                if g.group(4).strip() != '0>':
+                    fail('translational motion is not supported')
+                rest.add(g.group(1).lower())
+            elif match(r'kindiffs\(\s*(\w+)\s*,\s*(\w+)\s*,\s*(\w+)\s*,(.*)\)'):
+                g = match(r'kindiffs\(\s*(\w+)\s*,\s*(\w+)\s*,\s*(\w+)\s*,(.*)\)')
+                frames(g.group(1), g.group(2))
+                ek = euler(g.group(3), g.group(4))
+                if w is None:
+                    fail('the angular velocity must be declared before kindiffs')
+                qdot = euler_kindiffs(ek, w)
+            elif match(r'alf_(\w+)_(\w+)>\s*=\s*dt\(\s*w_(\w+)_(\w+)>\s*,\s*(\w+)\s*\)'):
+                g = match(r'alf_(\w+)_(\w+)>\s*=\s*dt\(\s*w_(\w+)_(\w+)>\s*,\s*(\w+)\s*\)')
+                frames(g.group(2), g.group(1))
+                frames(g.group(4), g.group(3))
+                frames(g.group(5), body)
+            elif match(r'torque_(\w+)>\s*=(.*)'):
+                g = match(r'torque_(\w+)>\s*=(.*)')
+                frames(N, g.group(1))
+                T = vector(g.group(2), body, names)
+            elif match(r'zero\s*=\s*fr\(\)\s*\+\s*frstar\(\)'):
+                pass
+            elif match(r'solve\(\s*zero\s*,\s*\[(.*)\]\s*\)'):
+                g = match(r'solve\(\s*zero\s*,\s*\[(.*)\]\s*\)')
+                if declared(g.group(1), 'equations') != us:
+                    fail('zero must be solved for %s' % ', '.join("%s'" % u for u in us))
+                solved = True
+            elif match(r'states\s*=\s*\[(.*)\]'):
+                states = expand_names(match(r'states\s*=\s*\[(.*)\]').group(1))
+                if sorted(states) != sorted(qs + us):
+                    fail('states must list each variable and motion variable once')
+            elif match(r'f\s*=\s*\[(.*)\]'):
+                f = [t.strip() for t in match(r'f\s*=\s*\[(.*)\]').group(1).split(';')]
+                if not states or f != ["rhs(%s')" % s for s in states]:
+                    fail('f must be [rhs(x\'); ...] over the states, in order')
+            elif match(r'a\s*=\s*d\(\s*f\s*,\s*states\s*\)'):
+                if f is None:
+                    fail('f must be declared before A')
+                linearized = True
+            elif match(r'b\s*=\s*\[(.*)\]'):
+                if f is None:
+                    fail('f must be declared before B')
+                rows = [split_top(r, ',') for r in match(r'b\s*=\s*\[(.*)\]').group(1).split(';')]
+                if len(rows) != len(states) or len(set(map(len, rows))) != 1:
+                    fail('B must have one row per state and the same number of columns in each')
+                for i, row in enumerate(rows):
+                    for j, t in enumerate(row):
+                        g = re.match(r'd\(\s*f\[(\d+)\]\s*,\s*(\w+)\s*\)$', t)
+                        if t == '0':
+                            continue
+                        if not g or int(g.group(1)) != i + 1 or g.group(2) not in constants:
+                            fail('B entries must be 0 or d(f[row], constant), not %s' % t)
+                        if len(inputs) <= j:
+                            inputs.extend([None] * (j + 1 - len(inputs)))
+                        if inputs[j] not in (None, g.group(2)):
+                            fail('column %d of B mixes %s and %s' % (j + 1, inputs[j], g.group(2)))
+                        inputs[j] = g.group(2)
+                if len(inputs) < len(rows[0]) or None in inputs:
+                    fail('every column of B needs at least one d(f[row], constant)')
+                Bform = rows
+            elif match(r'm\s*=\s*\[(.*)\]'):
+                if NA is None:
+                    fail('dircos must come before m')
+                m = []
+                for item in split_top(match(r'm\s*=\s*\[(.*)\]').group(1), ','):
+                    ij = re.match(r'(\w+)_(\w+)\[([123])\s*,\s*([123])\]$', item)
+                    if ij:
+                        frames(ij.group(1), ij.group(2))
+                        m.append(NA[int(ij.group(3)) - 1][int(ij.group(4)) - 1])
+                    else:
+                        m.append(expr(item))
+                if len(m) != 16:
+                    fail('m must have 16 entries')
+            elif match(r'(input|output)\s+(.*)'):
+                # Values for Autolev's own code; the names must still exist
+                g = match(r'(input|output)\s+(.*)')
+                for t in g.group(2).split(','):
+                    n = re.match(r'\s*(\w+)\s*(=\s*[-+]?[\d.]+(?:[eE][-+]?\d+)?\s*)?$', t)
+                    if not n or n.group(1) not in names and \
+                       not (g.group(1).lower() == 'output' and n.group(1) in ('m', 'A', 'B')):
+                        fail('cannot interpret %s %s' % (g.group(1), t.strip()))
+            else:
+                fail('cannot interpret %s' % l)
+
+        except SystemExit as x:
+            # Errors from the expression parser don't know the line
+            if not str(x).startswith('genkernels.py: %s' % path):
+                fail(str(x).replace('genkernels.py: ', '', 1))
+            raise
+        names = dict((n, sym(n)) for n in constants + qs + us)
+
+    where[0] = path
+    for ok, what in ((N and body, 'newtonian and body'), (I, 'inertia'),
+                     (NA, 'dircos'), (w, 'angular velocity'), (qdot, 'kindiffs'),
+                     (rest == set('va'), 'v and a of the mass center, as 0>'),
+                     (solved, 'solve(zero, ...)'), (states, 'states'), (f, 'f'),
+                     (linearized, 'A = d(f, states)'), (m, 'm')):
+        if not ok:
+            fail('missing %s' % what)
+
+    # Kane's equations: W^T (I W u' + w x I w - T) = 0 with W = dw/du, solved
+    # through the adjugate so only the reciprocal of det(M) is needed
+    W = [[diff(w[i], u.key[1]) for u in map(sym, us)] for i in range(3)]
+    if any(W[i][j].free & set(qs + us) for i in range(3) for j in range(3)):
+        raise SystemExit('genkernels.py: angular velocity must be linear in the motion variables')
+    IW = [[add(*[mul(I[i][k], W[k][j]) for k in range(3)]) for j in range(3)] for i in range(3)]
+    M = [[add(*[mul(W[k][i], IW[k][j]) for k in range(3)]) for j in range(3)] for i in range(3)]
+    Iw = [add(*[mul(I[i][k], w[k]) for k in range(3)]) for i in range(3)]
+    wxIw = cross(w, Iw)
+    r = [sub(T[i], wxIw[i]) for i in range(3)]
+    rhs = [add(*[mul(W[k][i], r[k]) for k in range(3)]) for i in range(3)]
+    adj, rdet = adj3(M), inv(det3(M))
+    Minv = [[mul(adj[i][j], rdet) for j in range(3)] for i in range(3)]
+    udot = [add(*[mul(Minv[i][j], rhs[j]) for j in range(3)]) for i in range(3)]
+
+    rates = dict(zip(qs + us, qdot + udot))
+    f = [rates[s] for s in states]
+    A = [diff(fi, s) for fi in f for s in states]
+    B = [diff(fi, u) for fi in f for u in inputs]
+    for i, row in enumerate(Bform):
+        for j, t in enumerate(row):
+            if t == '0' and B[i*len(inputs) + j] is not ZERO:
+                fail('B[%d,%d] is written as 0 but d(f[%d], %s) is not zero'
+                     % (i + 1, j + 1, i + 1, inputs[j]))
+
+    return list(constants), states, f, A, B, m
+
+# ---------------------------------------------------------------------------
+# Hoisting of constant-only subexpressions and code emission
+
+def regroup(x, params, memo):
+    """Rebuild x so that constant-only factors of products and constant-only
+    terms of sums are grouped into their own nodes, which can then be hoisted
+    as a whole."""
+    if x.id in memo:
+        return memo[x.id]
+    kind = x.kind
+    if kind in ('num', 'sym') or x.free <= params:
+        y = x
+    elif kind == 'inv':
+        y = _node(('inv', regroup(x.key[1], params, memo)), x.free)
+    elif kind == 'mul':
+        f = [regroup(n, params, memo) for n in x.key[1]]
+        k = [n for n in f if n.free <= params]
+        if len(k) > 1:
+            f = [n for n in f if not n.free <= params] + [_mul(k)]
+        y = _mul(f)
+    else:
+        c0, terms = x.key[1], [(c, regroup(n, params, memo)) for c, n in x.key[2]]
+        k = [t for t in terms if t[1].free <= params]
+        if len(k) > 1 or (k and c0 != 0):
+            terms = [t for t in terms if not t[1].free <= params] + [(Fraction(1), _lin(c0, k))]
+            c0 = Fraction(0)
+        y = _lin(c0, terms)
+    memo[x.id] = y
+    return y
+
+def children(x):
+    if x.kind == 'lin':
+        return [n for c, n in x.key[2]]
+    if x.kind == 'mul':
+        return list(x.key[1])
+    if x.kind == 'inv':
+        return [x.key[1]]
+    return []
+
+def literal(v):
+    s = repr(float(v))
+    return s if 'e' in s or '.' in s else s + '.0'
+
+class Emitter(object):
+    """Emits C++ for a set of outputs.  With cse, every node used more than
+    once gets a const local; without it every use is expanded in place, which
+    gives the op count of the plain expression trees."""
+
+    def __init__(self, leaves, cse=True):
+        self.leaves = leaves   # node -> C++ name for symbols and hoisted nodes
+        self.cse = cse
+        self.names = {}
+        self.ops = Counter()
+        self.lines = []
+
+    def run(self, outputs):
+        uses = Counter()
+        seen = set()
+
+        def visit(x):
+            uses[x] += 1
+            if x in seen or x in self.leaves:
+                return
+            seen.add(x)
+            for c in children(x):
+                visit(c)
+
+        for target, x in outputs:
+            visit(x)
+        self.temps = set(x for x, k in uses.items()
+                         if self.cse and k > 1 and x not in self.leaves and children(x))
+        order = []
+        done = set()
+
+        def topo(x):
+            if x in done or x in self.leaves:
+                return
+            done.add(x)
+            for c in children(x):
+                topo(c)
+            if x in self.temps:
+                order.append(x)
+
+        for target, x in outputs:
+            topo(x)
+        for x in order:
+            name = 'z%d' % len(self.names)
+            self.lines.append('const double %s = %s;' % (name, self.expr(x)))
+            self.names[x] = name
+        for target, x in outputs:
+            self.lines.append('%s = %s;' % (target, self.expr(x)))
+        return self
+
+    def expr(self, x, paren=False):
+        if x in self.leaves:
+            return self.leaves[x]
+        if x in self.names:
+            return self.names[x]
+        kind = x.kind
+        if kind == 'num':
+            v = x.key[1]
+            return ('(%s)' if paren and v < 0 else '%s') % literal(v)
+        if kind == 'inv':
+            self.ops['/'] += 1
+            return '1.0/%s' % self.expr(x.key[1], True)
+        if kind == 'mul':
+            num_, den = [], []
+            for n in x.key[1]:
+                if n.kind == 'inv' and n not in self.names and n not in self.leaves:
+                    den.append(self.expr(n.key[1], True))
+                else:
+                    num_.append(self.expr(n, True))
+            self.ops['*'] += max(len(num_) - 1, 0)
+            self.ops['/'] += len(den)
+            s = '*'.join(num_ or ['1.0']) + ''.join('/' + d for d in den)
+            return '(%s)' % s if paren and den else s
+        # lin: positive terms first to avoid a leading negation
+        c0, terms = x.key[1], sorted(x.key[2], key=lambda t: t[0] < 0)
+        parts = []
+        for c, n in terms:
+            a = abs(c)
+            body = self.expr(n, True)
+            if a != 1:
+                self.ops['*'] += 1
+                body = '%s*%s' % (literal(a), body)
+            parts.append((c < 0, body))
+        if c0 != 0:
+            parts.insert(0, (c0 < 0, literal(abs(c0))))
+        s = ('-' if parts[0][0] else '') + parts[0][1]
+        for negative, body in parts[1:]:
+            s += (' - ' if negative else ' + ') + body
+        self.ops['+'] += len(parts) - 1
+        if parts[0][0]:
+            self.ops['neg'] += 1
+        return '(%s)' % s if paren and len(parts) > 1 else s
+
+def fmt_ops(c):
+    return ', '.join('%d %s' % (c[k], k) for k in ('+', '*', '/') if c[k])
+
+def main(argv):
+    if len(argv) < 2:
+        raise SystemExit('usage: %s rigidbody.al > rigidbodykernels.hpp' % argv[0])
+    params, states, f, A, B, m = model(argv[1])
+    nx = len(states)
+
+    pset = frozenset(params)
+    memo = {}
+    f, A, B, m = [[regroup(x, pset, memo) for x in v] for v in (f, A, B, m)]
+
+    # Maximal constant-only subexpressions used by the state kernels
+    hoisted = []
+
+    def collect(x, seen):
+        if x in seen:
+            return
+        seen.add(x)
+        if x.free <= pset:
+            if children(x) and x not in hoisted:
+                hoisted.append(x)
+            return
+        for c in children(x):
+            collect(c, seen)
+
+    seen = set()
+    for x in f + A + B + m:
+        collect(x, seen)
+
+    leaves = dict((sym(n), 'p.%s' % n) for n in params)
+    leaves.update((sym(s), s) for s in states)
+    hleaves = dict(leaves)
+    hleaves.update((x, 'c[%d]' % i) for i, x in enumerate(hoisted))
+
+    kc = Emitter(leaves).run([('c[%d]' % i, x) for i, x in enumerate(hoisted)])
+    kf = Emitter(hleaves).run([('f[%d]' % i, x) for i, x in enumerate(f)])
+    km = Emitter(hleaves).run([('m[%d]' % i, x) for i, x in enumerate(m)])
+    kab = Emitter(hleaves).run([('A[%d]' % i, x) for i, x in enumerate(A)] +
+                               [('B[%d]' % i, x) for i, x in enumerate(B)])
+    tf = Emitter(leaves, cse=False).run([('f', x) for x in f])
+    tm = Emitter(leaves, cse=False).run([('m', x) for x in m])
+    tab = Emitter(leaves, cse=False).run([('A', x) for x in A + B])
+
+    report = [
+        'Op counts per call, generated from %s:' % argv[1],
+        '  constants (once per parameter set): %s' % fmt_ops(kc.ops),
+        '  equations of motion:  %s, expression trees %s' % (fmt_ops(kf.ops), fmt_ops(tf.ops)),
+        '  transformation m:     %s, expression trees %s' % (fmt_ops(km.ops), fmt_ops(tm.ops)),
+        '  linearization A, B:   %s, expression trees %s' % (fmt_ops(kab.ops), fmt_ops(tab.ops)),
+    ]
+    sys.stderr.write('\n'.join(report) + '\n')
+
+    def body(k):
+        return ''.join('  %s\n' % l for l in k.lines)
+
+    def unpack(used):
+        return ''.join('  const double %s = x[%d];\n' % (s, i)
+                       for i, s in enumerate(states) if s in used)
+
+    def used_states(k):
+        return set(s for s in states if re.search(r'\b%s\b' % s, ''.join(k.lines)))
+
+    def unused(k, name):
+        return '' if re.search(r'\b%s\b' % re.escape(name), ''.join(k.lines)) else \
+            '  (void) %s;\n' % name
+
+    out = []
+    w = out.append
+    w('''/*
+ * =====================================================================================
+ *
+ *       Filename:  rigidbodykernels.hpp
+ *
+ *    Description:  Equations of motion, linearization and transformation
+ *    matrix of the rigid body in rigidbody.al.  Generated by genkernels.py,
+ *    regenerate with "make kernels" rather than editing by hand.
+ *
+ *    Parameter-only subexpressions are evaluated once by evalConstants();
+ *    the other kernels take its result and keep all temporaries in locals.
+ *
+''')
+    for l in report:
+        w(' *    %s\n' % l)
+    w(''' *
+ * =====================================================================================
+ */
+
+#ifndef  RIGIDBODYKERNELS_HPP
+#define  RIGIDBODYKERNELS_HPP
+
+#include <array>
+
+namespace rigidbody {
+
+using KernelConstants = std::array<double, %d>;
+
+''' % len(hoisted))
+    w('''// P is any type with members %s
+template <class P>
+constexpr void evalConstants(const P & p, KernelConstants & c) noexcept
+{
+%s%s}
+
+''' % (', '.join(n for n in params if any(re.search(r'\bp\.%s\b' % n, l) for l in kc.lines)),
+       unused(kc, 'p'), body(kc)))
+    w('''// state ordering:  [%s]
+template <class P>
+constexpr void evalEoms(const P & p, const KernelConstants & c,
+                        const std::array<double, %d> & x, std::array<double, %d> & f) noexcept
+{
+%s%s%s}
+
+''' % (', '.join(states), nx, nx, unused(kf, 'p'), unpack(used_states(kf)), body(kf)))
+    w('''// 4x4 transformation matrix, column-major format as used by OpenGL
+constexpr void evalTransform(const std::array<double, %d> & x, std::array<double, %d> & m) noexcept
+{
+%s%s}
+
+''' % (nx, len(m), unpack(used_states(km)), body(km)))
+    w('''// A = df/dx and B = df/du, row-major
+template <class P>
+constexpr void evalLinearization(const P & p, const KernelConstants & c,
+                                 const std::array<double, %d> & x,
+                                 std::array<double, %d> & A, std::array<double, %d> & B) noexcept
+{
+%s%s%s}
+
+} // namespace rigidbody
+
+#endif   /* ----- #ifndef RIGIDBODYKERNELS_HPP ----- */
+''' % (nx, len(A), len(B), unused(kab, 'p'), unpack(used_states(kab)), body(kab)))
+    sys.stdout.write(''.join(out))
+
+if __name__ == '__main__':
+    main(sys.argv)
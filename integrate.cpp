@@ -0,0 +1,153 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  integrate.cpp
+ *
+ *    Description:  Headless integration of the rigid body equations of motion
+ *    using only the allocation-free core in rigidbodycore.hpp.  Prints the
+ *    state at every output frame, or writes it in the compressed format of
+ *    trajcodec.hpp, no GSL or OpenGL required.
+ *
+ * =====================================================================================
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <optional>
+
+#include "rigidbodycore.hpp"
+#include "trajcodec.hpp"
+
+using namespace rigidbody;
+
+// The core can run entirely at compile time
+static_assert([] {
+  Integrator<4> rk(Model(Parameters{}), bogackiShampine32, 1e-6, 0.0);
+  State x = {0.0, 0.0, 0.0, 1.0, 0.0, 1.0, 0.0};
+  double t = 0.0, h = 1e-3;
+  return rk.advance(t, 0.1, h, x) == Success && t == 0.1;
+}());
+
+int main(int argc, char ** argv)
+{
+  Parameters p;
+  State x = {0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0};
+  double t = 0.0, tf = 20.0, h = 1e-3, fps = 60.0, rateq = 1e-6;
+  int c, opt_index, k, qbits = 16, block = 256;
+  char * out = NULL;
+  struct option long_options[] = {
+     {"help", no_argument, 0, '?'},
+     {"Ixx",  required_argument, 0, 'a'},
+     {"Iyy",  required_argument, 0, 'b'},
+     {"Izz",  required_argument, 0, 'c'},
+     {"Ixy",  required_argument, 0, 'd'},
+     {"Iyz",  required_argument, 0, 'e'},
+     {"Ixz",  required_argument, 0, 'f'},
+     {"wx",  required_argument, 0, 'g'},
+     {"wy",  required_argument, 0, 'h'},
+     {"wz",  required_argument, 0, 'i'},
+     {"tf",  required_argument, 0, 't'},
+     {"fps",  required_argument, 0, 'r'},
+     {"out",  required_argument, 0, 'o'},
+     {"qbits",  required_argument, 0, 'q'},
+     {"rateq",  required_argument, 0, 'w'},
+     {"block",  required_argument, 0, 'k'},
+     {0, 0, 0, 0} };
+  while (1) {
+    opt_index = 0;
+    c = getopt_long(argc, argv, "?a:b:c:d:e:f:g:h:i:t:r:o:q:w:k:", long_options, &opt_index);
+
+  if (c == -1)
+    break;
+
+  switch (c) {
+    case '?':
+      printf(
+"usage: %s [OPTION]\n\n"
+"  -?, --help                   Display this help and exit.\n"
+"  --Ixx=val                    Ixx moment of inertia.\n"
+"  --Iyy=val                    Iyy moment of inertia.\n"
+"  --Izz=val                    Izz moment of inertia.\n"
+"  --Ixy=val                    Ixy product of inertia.\n"
+"  --Iyz=val                    yz product of inertia.\n"
+"  --Ixz=val                    Ixz product of inertia.\n"
+"  --wx=val                     Initial angular velocity about body-fixed x axis\n"
+"  --wy=val                     Initial angular velocity about body-fixed y axis\n"
+"  --wz=val                     Initial angular velocity about body-fixed z axis\n"
+"  -t val, --tf=val             Total simulation time\n"
+"  --fps=val                    Output points per unit time\n"
+"  -o file, --out=file          Write compressed trajectory to file\n"
+"  --qbits=val                  Bits per stored Euler parameter, 4 to 20 (16)\n"
+"  --rateq=val                  Angular velocity quantum (1e-6)\n"
+"  --block=val                  Samples per independently decodable block (256)\n\n"
+"Prints one line per output point: t e0 e1 e2 e3 wx wy wz\n"
+"With --out nothing is printed except the reconstruction error bounds; use\n"
+"trajdump to decode.\n\n",
+             argv[0]);
+      exit(0);
+
+    case 'a': p.Ixx = atof(optarg); break;
+    case 'b': p.Iyy = atof(optarg); break;
+    case 'c': p.Izz = atof(optarg); break;
+    case 'd': p.Ixy = atof(optarg); break;
+    case 'e': p.Iyz = atof(optarg); break;
+    case 'f': p.Ixz = atof(optarg); break;
+    case 'g': x[4] = atof(optarg); break;
+    case 'h': x[5] = atof(optarg); break;
+    case 'i': x[6] = atof(optarg); break;
+    case 't': tf = atof(optarg); break;
+    case 'r': fps = atof(optarg); break;
+    case 'o': out = optarg; break;
+    case 'q': qbits = atoi(optarg); break;
+    case 'w': rateq = atof(optarg); break;
+    case 'k': block = atoi(optarg); break;
+    default: abort();
+    } // switch(c)
+  } // while
+
+  FILE * fp = NULL;
+  if (out && !(fp = fopen(out, "wb"))) {
+    fprintf(stderr, "could not write %s\n", out);
+    return 1;
+  }
+  Integrator<7> rk(Model(p), dormandPrince54, 1e-6, 0.0);
+  std::optional<TrajectoryWriter> writer;
+  if (out) {
+    writer.emplace(fp, qbits, rateq, block, 0.0, 1.0 / fps);
+    if (writer->status() == Invalid) {
+      fprintf(stderr, "%s: --rateq must be positive and finite\n", argv[0]);
+      fclose(fp);
+      return 1;
+    }
+  }
+  for (k = 0; ; ++k) {
+    if (out)
+      writer->add(x);
+    else
+      printf("%.6f %.16e %.16e %.16e %.16e %.16e %.16e %.16e\n",
+             t, x[0], x[1], x[2], x[3], x[4], x[5], x[6]);
+    if (k == (int) (fps * tf))
+      break;
+    if (rk.advance(t, (k + 1) / fps, h, x) != Success) {
+      fprintf(stderr, "integration failed at t = %g\n", t);
+      return 1;
+    }
+  }
+
+  if (out) {
+    if (writer->finish() != Success || fclose(fp) != 0) {
+      fprintf(stderr, "could not write %s\n", out);
+      return 1;
+    }
+    fprintf(stderr,
+            "%d samples, %llu bytes (%.2f per sample, raw doubles 56)\n"
+            "rotation error bound %.3e rad, max %.3e rad\n"
+            "angular velocity error bound %.3e, max %.3e\n",
+            k + 1, (unsigned long long) writer->bytes(), writer->bytes() / (k + 1.0),
+            writer->quaternionBound(), writer->maxQuaternionError(),
+            writer->rateBound(), writer->maxRateError());
+  }
+  return 0;
+}
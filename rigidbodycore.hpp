@@ -0,0 +1,284 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  rigidbodycore.hpp
+ *
+ *    Description:  Header-only, allocation-free stepping core for the rigid
+ *    body equations of motion, built on the kernels generated into
+ *    rigidbodykernels.hpp; the GSL program (rigidbodyeoms.c) evaluates the
+ *    same kernels through rigidbodyshim.h.  Fixed-size state,
+ *    compile-time-sized Butcher tableaux for embedded Runge-Kutta pairs,
+ *    quaternion normalization and the 4x4 OpenGL transformation matrix.
+ *    Needs no GSL, no heap, and everything is usable in constexpr and
+ *    noexcept contexts.
+ *
+ * =====================================================================================
+ */
+
+#ifndef  RIGIDBODYCORE_HPP
+#define  RIGIDBODYCORE_HPP
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+
+#include "rigidbodykernels.hpp"
+
+namespace rigidbody {
+
+// state ordering:  [e0, e1, e2, e3, u0, u1, u2]
+//                    0   1   2   3   4   5   6
+using State = std::array<double, 7>;
+// 4x4 transformation matrix, column-major format as used by OpenGL
+using Transform = std::array<double, 16>;
+
+// Return codes, same values as GSL_SUCCESS, GSL_FAILURE and GSL_EINVAL
+constexpr int Success = 0;
+constexpr int Failure = -1;
+constexpr int Invalid = 4;
+
+// std::sqrt and std::pow are not constexpr; fall back to Newton iteration
+// when evaluated at compile time and use libm otherwise.
+constexpr double squareRoot(double x) noexcept
+{
+  if (!std::is_constant_evaluated())
+    return std::sqrt(x);
+  if (!(x > 0.0))
+    return 0.0;
+  double y = x > 1.0 ? x : 1.0, yp = 0.0;
+  for (int i = 0; i < 200 && y != yp; ++i) {
+    yp = y;
+    y = 0.5*(y + x/y);
+  }
+  return y;
+} // squareRoot()
+
+// n-th root of x > 0
+constexpr double nthRoot(double x, int n) noexcept
+{
+  if (!std::is_constant_evaluated())
+    return std::pow(x, 1.0/n);
+  if (!(x > 0.0))
+    return 0.0;
+  double y = x > 1.0 ? x : 1.0, yp = 0.0;
+  for (int i = 0; i < 200 && y != yp; ++i) {
+    double yn1 = 1.0;
+    for (int j = 1; j < n; ++j)
+      yn1 *= y;
+    yp = y;
+    y = ((n - 1)*y + x/yn1)/n;
+  }
+  return y;
+} // nthRoot()
+
+constexpr double magnitude(double x) noexcept { return x < 0.0 ? -x : x; }
+
+// Mass properties and applied torques, defaults match initRigidBody()
+struct Parameters {
+  double Ixx = 1.0, Iyy = 2.0, Izz = 1.0, Ixy = 0.0, Iyz = 0.0, Ixz = 0.0;
+  double Tax = 0.0, Tay = 0.0, Taz = 0.0;
+};
+
+// Parameters together with their parameter-only subexpressions, which
+// only need to be evaluated once rather than at every function evaluation.
+struct Model {
+  Parameters p;
+  KernelConstants c{};
+
+  constexpr explicit Model(const Parameters & par) noexcept : p(par)
+  {
+    evalConstants(p, c);
+  }
+};
+
+// Equations of motion generated into rigidbodykernels.hpp from rigidbody.al,
+// also what eoms() in rigidbodyeoms.c evaluates
+constexpr void eoms(const Model & md, const State & x, State & f) noexcept
+{
+  evalEoms(md.p, md.c, x, f);
+} // eoms()
+
+// Scale the Euler parameters to unit length, returns the scale factor applied
+constexpr double normalize(State & x) noexcept
+{
+  const double s = 1.0/squareRoot(x[0]*x[0] + x[1]*x[1] + x[2]*x[2] + x[3]*x[3]);
+  x[0] *= s;
+  x[1] *= s;
+  x[2] *= s;
+  x[3] *= s;
+  return s;
+} // normalize()
+
+// Same matrix as m[] computed by evalOutputs() in rigidbodyeoms.c
+constexpr void transform(const State & x, Transform & m) noexcept
+{
+  evalTransform(x, m);
+} // transform()
+
+// Same A and B matrices as evalOutputs() in rigidbodyeoms.c, row-major
+constexpr void linearize(const Model & md, const State & x,
+                         std::array<double, 49> & A, std::array<double, 21> & B) noexcept
+{
+  evalLinearization(md.p, md.c, x, A, B);
+} // linearize()
+
+// Butcher tableau of an embedded Runge-Kutta pair with S stages.  b[] gives
+// the propagated solution of order `order`, bhat[] the embedded solution
+// used only for the error estimate.  fsal marks pairs whose last stage is
+// evaluated at the new state, so it can be reused as the next first stage.
+template <std::size_t S>
+struct ButcherTableau {
+  std::array<std::array<double, S>, S> a;
+  std::array<double, S> b, bhat, c;
+  int order;
+  bool fsal;
+};
+
+// Bogacki-Shampine 3(2)
+inline constexpr ButcherTableau<4> bogackiShampine32 = {
+  {{ {{0.0, 0.0, 0.0, 0.0}},
+     {{1.0/2.0, 0.0, 0.0, 0.0}},
+     {{0.0, 3.0/4.0, 0.0, 0.0}},
+     {{2.0/9.0, 1.0/3.0, 4.0/9.0, 0.0}} }},
+  {{2.0/9.0, 1.0/3.0, 4.0/9.0, 0.0}},
+  {{7.0/24.0, 1.0/4.0, 1.0/3.0, 1.0/8.0}},
+  {{0.0, 1.0/2.0, 3.0/4.0, 1.0}},
+  3, true
+};
+
+// Dormand-Prince 5(4)
+inline constexpr ButcherTableau<7> dormandPrince54 = {
+  {{ {{0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0}},
+     {{1.0/5.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0}},
+     {{3.0/40.0, 9.0/40.0, 0.0, 0.0, 0.0, 0.0, 0.0}},
+     {{44.0/45.0, -56.0/15.0, 32.0/9.0, 0.0, 0.0, 0.0, 0.0}},
+     {{19372.0/6561.0, -25360.0/2187.0, 64448.0/6561.0, -212.0/729.0, 0.0, 0.0, 0.0}},
+     {{9017.0/3168.0, -355.0/33.0, 46732.0/5247.0, 49.0/176.0, -5103.0/18656.0, 0.0, 0.0}},
+     {{35.0/384.0, 0.0, 500.0/1113.0, 125.0/192.0, -2187.0/6784.0, 11.0/84.0, 0.0}} }},
+  {{35.0/384.0, 0.0, 500.0/1113.0, 125.0/192.0, -2187.0/6784.0, 11.0/84.0, 0.0}},
+  {{5179.0/57600.0, 0.0, 7571.0/16695.0, 393.0/640.0, -92097.0/339200.0, 187.0/2100.0, 1.0/40.0}},
+  {{0.0, 1.0/5.0, 3.0/10.0, 4.0/5.0, 8.0/9.0, 1.0, 1.0}},
+  5, true
+};
+
+// Adaptive integrator for an embedded pair.  Step size control follows
+// gsl_odeiv_control_y_new(): the error of each component is scaled by
+// epsAbs + epsRel*|x_i|, and apply() behaves like gsl_odeiv_evolve_apply().
+template <std::size_t S>
+class Integrator {
+ public:
+  constexpr Integrator(const Model & model, const ButcherTableau<S> & tableau,
+                       double epsAbs, double epsRel) noexcept
+    : model_(model), tableau_(tableau), epsAbs_(epsAbs), epsRel_(epsRel)
+  { }
+
+  // Forget the cached first stage, needed whenever x is modified between
+  // calls to apply()
+  constexpr void reset() noexcept { haveK0_ = false; }
+
+  // Single step of size h from x, without error control
+  constexpr void step(double h, const State & x, State & xout, State & err) noexcept
+  {
+    const auto & a = tableau_.a;
+    if (!haveK0_) {
+      eoms(model_, x, k_[0]);
+      haveK0_ = true;
+    }
+    for (std::size_t s = 1; s < S; ++s) {
+      State xs{};
+      for (std::size_t i = 0; i < xs.size(); ++i) {
+        double sum = 0.0;
+        for (std::size_t j = 0; j < s; ++j)
+          sum += a[s][j]*k_[j][i];
+        xs[i] = x[i] + h*sum;
+      }
+      eoms(model_, xs, k_[s]);
+    }
+    for (std::size_t i = 0; i < x.size(); ++i) {
+      double sum = 0.0, sumErr = 0.0;
+      for (std::size_t j = 0; j < S; ++j) {
+        sum += tableau_.b[j]*k_[j][i];
+        sumErr += (tableau_.b[j] - tableau_.bhat[j])*k_[j][i];
+      }
+      xout[i] = x[i] + h*sum;
+      err[i] = h*sumErr;
+    }
+  } // step()
+
+  // Take one accepted step towards t1, retrying with a smaller step size
+  // until the error is within tolerance.  On success t and x are advanced
+  // and h holds the step size suggested for the next step.
+  constexpr int apply(double & t, double t1, double & h, State & x) noexcept
+  {
+    const double dt = t1 - t;
+    if (!(dt > 0.0) || !(h > 0.0))
+      return Invalid;
+
+    for (;;) {
+      const double h0 = h < dt ? h : dt;
+      State xout{}, err{};
+      step(h0, x, xout, err);
+
+      double r = 0.0;
+      for (std::size_t i = 0; i < x.size(); ++i) {
+        const double ri = magnitude(err[i])/(epsAbs_ + epsRel_*magnitude(xout[i]));
+        if (ri > r)
+          r = ri;
+      }
+
+      if (!(r <= 1.1)) {
+        // Reject and shrink, x is unchanged so k_[0] stays valid
+        double scale = r > 1.1 ? 0.9/nthRoot(r, tableau_.order) : 0.2;
+        h = h0*(scale > 0.2 ? scale : 0.2);
+        if (!(h > 1e-14*(magnitude(t) + dt)))
+          return Failure;
+        continue;
+      }
+
+      t = h0 < dt ? t + h0 : t1;
+      x = xout;
+      if (tableau_.fsal)
+        k_[0] = k_[S - 1];
+      else
+        haveK0_ = false;
+
+      if (r < 0.5) {
+        double scale = r > 0.0 ? 0.9/nthRoot(r, tableau_.order + 1) : 5.0;
+        scale = scale < 5.0 ? scale : 5.0;
+        if (h0*scale > h)
+          h = h0*scale;
+      }
+      return Success;
+    }
+  } // apply()
+
+  // Integrate from t to t1, renormalizing the Euler parameters after every
+  // accepted step as updateState() does in simulate.c
+  constexpr int advance(double & t, double t1, double & h, State & x) noexcept
+  {
+    while (t < t1) {
+      const int status = apply(t, t1, h, x);
+      if (status != Success)
+        return status;
+      // The kinematic equations are linear in the Euler parameters and the
+      // dynamic equations don't depend on them, so scaling the cached first
+      // stage keeps it exact without a new function evaluation.
+      const double s = normalize(x);
+      for (std::size_t i = 0; i < 4; ++i)
+        k_[0][i] *= s;
+    }
+    return Success;
+  } // advance()
+
+ private:
+  Model model_;
+  ButcherTableau<S> tableau_;
+  double epsAbs_, epsRel_;
+  std::array<State, S> k_{};
+  bool haveK0_ = false;
+};
+
+} // namespace rigidbody
+
+#endif   /* ----- #ifndef RIGIDBODYCORE_HPP ----- */
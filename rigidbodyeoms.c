@@ -14,200 +14,44 @@
  * =====================================================================================
  */
 
-#include <math.h>
 #include <getopt.h>
 #include <string.h>
 
 #include "rigidbodyeoms.h"
 
+static RigidBodyParameters parameters(const RigidBody * body)
+{
+  RigidBodyParameters p = {body->Ixx, body->Iyy, body->Izz, body->Ixy, body->Iyz,
+                           body->Ixz, body->Tax, body->Tay, body->Taz};
+  return p;
+} // parameters()
+
+// Evaluated by the kernels generated from rigidbody.al, through rigidbodyshim.h
 int eoms(const double t, const double *VAR, double VARp[], void *params)
 {
-  // state ordering:  [e0, e1, e2, e3,  x,  y,  z, u0, u1, u2, u3, u4, u5]
-  //                    0   1   2   3   4   5   6   7   8   9  10  11  12
+  // state ordering:  [e0, e1, e2, e3, u0, u1, u2]
+  //                    0   1   2   3   4   5   6
   RigidBody * body = (RigidBody *) params;
-  double  e0, e1, e2, e3, u0, u1, u2, e0p, e1p, e2p, e3p, u0p, u1p, u2p;
-
-  double Ixx = body->Ixx, Iyy = body->Iyy, Izz = body->Izz, Ixy = body->Ixy, Iyz = body->Iyz, Ixz = body->Ixz;
-  double Tax = body->Tax, Tay = body->Tay, Taz = body->Taz;
-
-  // Determine magnitude of quaternion
-  double mag = 1.0; sqrt(VAR[0]*VAR[0] + VAR[1]*VAR[1] + VAR[2]*VAR[2] + VAR[3]*VAR[3]);
-  double * z = body->z;
-
-  /* Evaluate constants */
-  z[21] = Ixy*Iyz - Ixz*Iyy;
-  z[20] = Ixx*Iyz - Ixy*Ixz;
-  z[19] = Ixx*Iyy - pow(Ixy,2);
-  z[22] = Iyz*z[20] - Ixz*z[21] - Izz*z[19];
-  z[23] = Iyy*Izz - pow(Iyz,2);
-  z[24] = Ixy*Izz - Ixz*Iyz;
-  z[25] = Ixx*Izz - pow(Ixz,2);
-
-/* Update variables after integration step */
-  e0 = VAR[0]/mag;
-  e1 = VAR[1]/mag;
-  e2 = VAR[2]/mag;
-  e3 = VAR[3]/mag;
-  u0 = VAR[4];
-  u1 = VAR[5];
-  u2 = VAR[6];
+  RigidBodyParameters p = parameters(body);
 
-  e0p = 0.5*e1*u2 + 0.5*e3*u0 - 0.5*e2*u1;
-  e1p = 0.5*e2*u0 + 0.5*e3*u1 - 0.5*e0*u2;
-  e2p = 0.5*e0*u1 + 0.5*e3*u2 - 0.5*e1*u0;
-  e3p = -0.5*e0*u0 - 0.5*e1*u1 - 0.5*e2*u2;
-  z[11] = Ixy*u0 + Iyy*u1 + Iyz*u2;
-  z[10] = Ixx*u0 + Ixy*u1 + Ixz*u2;
-  z[13] = u0*z[11] - u1*z[10];
-  z[18] = z[13] - Taz;
-  z[12] = Ixz*u0 + Iyz*u1 + Izz*u2;
-  z[15] = u1*z[12] - u2*z[11];
-  z[16] = z[15] - Tax;
-  z[14] = u2*z[10] - u0*z[12];
-  z[17] = z[14] - Tay;
-  z[26] = (z[21]*z[18]+z[23]*z[16]-z[24]*z[17])/z[22];
-  u0p = z[26];
-  z[27] = (z[20]*z[18]+z[24]*z[16]-z[25]*z[17])/z[22];
-  u1p = -z[27];
-  z[28] = (z[20]*z[17]-z[19]*z[18]-z[21]*z[16])/z[22];
-  u2p = -z[28];
-
-/* Update derivative array prior to integration step */
-  VARp[0] = e0p;
-  VARp[1] = e1p;
-  VARp[2] = e2p;
-  VARp[3] = e3p;
-  VARp[4] = u0p;
-  VARp[5] = u1p;
-  VARp[6] = u2p;
+  rigidbodyEoms(&p, body->kc, VAR, VARp);
   // Return sucess
   return GSL_SUCCESS;
 } // eoms()
 
 void evalOutputs(RigidBody * body)
 {
-  double  e0 = body->x[0], e1 = body->x[1], e2 = body->x[2], e3 = body->x[3], u0 = body->x[4], u1 = body->x[5], u2 = body->x[6];
-  double * m = body->m, * A = body->A, * B = body->B;
+  RigidBodyParameters p = parameters(body);
 
-  double Ixx = body->Ixx, Iyy = body->Iyy, Izz = body->Izz, Ixy = body->Ixy, Iyz = body->Iyz, Ixz = body->Ixz;
-  double * z = body->z;
+  rigidbodyOutputs(&p, body->kc, body->x, body->m, body->A, body->B);
+} // evalOutputs()
 
-/* Evaluate output quantities */
-  z[1] = 1 - 2*pow(e1,2) - 2*pow(e2,2);
-  z[2] = 2*e0*e1 - 2*e2*e3;
-  z[3] = 2*e0*e2 + 2*e1*e3;
-  z[4] = 2*e0*e1 + 2*e2*e3;
-  z[5] = 1 - 2*pow(e0,2) - 2*pow(e2,2);
-  z[6] = 2*e1*e2 - 2*e0*e3;
-  z[7] = 2*e0*e2 - 2*e1*e3;
-  z[8] = 2*e0*e3 + 2*e1*e2;
-  z[9] = 1 - 2*pow(e0,2) - 2*pow(e1,2);
-  z[29] = Ixy*u0 + z[11] - Ixx*u1;
-  z[30] = Ixz*u1 - Ixy*u2;
-  z[31] = Ixx*u2 - Ixz*u0 - z[12];
-  z[32] = (z[21]*z[29]+z[23]*z[30]-z[24]*z[31])/z[22];
-  z[33] = Iyy*u0 - Ixy*u1 - z[10];
-  z[34] = Iyz*u1 + z[12] - Iyy*u2;
-  z[35] = Ixy*u2 - Iyz*u0;
-  z[36] = (z[21]*z[33]+z[23]*z[34]-z[24]*z[35])/z[22];
-  z[37] = Iyz*u0 - Ixz*u1;
-  z[38] = Izz*u1 - Iyz*u2 - z[11];
-  z[39] = Ixz*u2 + z[10] - Izz*u0;
-  z[40] = (z[21]*z[37]+z[23]*z[38]-z[24]*z[39])/z[22];
-  z[41] = (z[20]*z[29]+z[24]*z[30]-z[25]*z[31])/z[22];
-  z[42] = (z[20]*z[33]+z[24]*z[34]-z[25]*z[35])/z[22];
-  z[43] = (z[20]*z[37]+z[24]*z[38]-z[25]*z[39])/z[22];
-  z[44] = (z[20]*z[31]-z[19]*z[29]-z[21]*z[30])/z[22];
-  z[45] = (z[20]*z[35]-z[19]*z[33]-z[21]*z[34])/z[22];
-  z[46] = (z[20]*z[39]-z[19]*z[37]-z[21]*z[38])/z[22];
+void updateConstants(RigidBody * body)
+{
+  RigidBodyParameters p = parameters(body);
 
-  m[0] = z[1];
-  m[1] = z[4];
-  m[2] = z[7];
-  m[3] = 0;
-  m[4] = z[2];
-  m[5] = z[5];
-  m[6] = z[8];
-  m[7] = 0;
-  m[8] = z[3];
-  m[9] = z[6];
-  m[10] = z[9];
-  m[11] = 0;
-  m[12] = 0;
-  m[13] = 0;
-  m[14] = 0;
-  m[15] = 1;
-  A[0] = 0;
-  A[1] = 0.5*u2;
-  A[2] = -0.5*u1;
-  A[3] = 0.5*u0;
-  A[4] = 0.5*e3;
-  A[5] = -0.5*e2;
-  A[6] = 0.5*e1;
-  A[7] = -0.5*u2;
-  A[8] = 0;
-  A[9] = 0.5*u0;
-  A[10] = 0.5*u1;
-  A[11] = 0.5*e2;
-  A[12] = 0.5*e3;
-  A[13] = -0.5*e0;
-  A[14] = 0.5*u1;
-  A[15] = -0.5*u0;
-  A[16] = 0;
-  A[17] = 0.5*u2;
-  A[18] = -0.5*e1;
-  A[19] = 0.5*e0;
-  A[20] = 0.5*e3;
-  A[21] = -0.5*u0;
-  A[22] = -0.5*u1;
-  A[23] = -0.5*u2;
-  A[24] = 0;
-  A[25] = -0.5*e0;
-  A[26] = -0.5*e1;
-  A[27] = -0.5*e2;
-  A[28] = 0;
-  A[29] = 0;
-  A[30] = 0;
-  A[31] = 0;
-  A[32] = z[32];
-  A[33] = z[36];
-  A[34] = z[40];
-  A[35] = 0;
-  A[36] = 0;
-  A[37] = 0;
-  A[38] = 0;
-  A[39] = -z[41];
-  A[40] = -z[42];
-  A[41] = -z[43];
-  A[42] = 0;
-  A[43] = 0;
-  A[44] = 0;
-  A[45] = 0;
-  A[46] = -z[44];
-  A[47] = -z[45];
-  A[48] = -z[46];
-  B[0] = 0;
-  B[1] = 0;
-  B[2] = 0;
-  B[3] = 0;
-  B[4] = 0;
-  B[5] = 0;
-  B[6] = 0;
-  B[7] = 0;
-  B[8] = 0;
-  B[9] = 0;
-  B[10] = 0;
-  B[11] = 0;
-  B[12] = -z[23]/z[22];
-  B[13] = z[24]/z[22];
-  B[14] = -z[21]/z[22];
-  B[15] = z[24]/z[22];
-  B[16] = -z[25]/z[22];
-  B[17] = z[20]/z[22];
-  B[18] = -z[21]/z[22];
-  B[19] = z[20]/z[22];
-  B[20] = -z[19]/z[22];
-} // evalOutputs()
+  rigidbodyConstants(&p, body->kc);
+} // updateConstants()
 
 void initRigidBody(RigidBody * body)
 {
@@ -253,6 +97,8 @@ void initRigidBody(RigidBody * body)
   // These entries of the 4x4 transformation matrix are constant
   body->m[3] = body->m[7] = body->m[11] = 0.0;
   body->m[15] = 1.0;
+
+  updateConstants(body);
 } // initRigidBody()
 
 void freeRigidBody(RigidBody * body)
@@ -330,4 +176,5 @@ void processOptions(int argc, char ** argv, RigidBody * body)
     default: abort();
     } // switch(c)
   } // while
+  updateConstants(body);
 } // processOptions()
@@ -17,11 +17,15 @@
 #include <gsl/gsl_errno.h>
 #include <gsl/gsl_odeiv.h>
 
+#include "rigidbodyshim.h"
+
 typedef struct {
   double g, ma, Ixx, Iyy, Izz, Ixy, Iyz, Ixz;
   double Tax, Tay, Taz;
   double ke, pe, te;
-  double x[7], f[7], z[47];
+  double x[7], f[7];
+  // Parameter-only subexpressions, computed by updateConstants()
+  double kc[RIGIDBODY_CONSTANTS];
   // 4x4 transformation matrix
   double m[16];
   // A and B matrices
@@ -44,6 +48,8 @@ typedef struct {
 
 int eoms(const double t, const double *x, double f[], void *params);
 void evalOutputs(RigidBody * body);
+// Recompute body->kc, needed whenever the mass properties change
+void updateConstants(RigidBody * body);
 void initRigidBody(RigidBody * body);
 void freeRigidBody(RigidBody * body);
 void processOptions(int argc, char ** argv, RigidBody * body);
@@ -0,0 +1,230 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  rigidbodykernels.hpp
+ *
+ *    Description:  Equations of motion, linearization and transformation
+ *    matrix of the rigid body in rigidbody.al.  Generated by genkernels.py,
+ *    regenerate with "make kernels" rather than editing by hand.
+ *
+ *    Parameter-only subexpressions are evaluated once by evalConstants();
+ *    the other kernels take its result and keep all temporaries in locals.
+ *
+ *    Op counts per call, generated from rigidbody.al:
+ *      constants (once per parameter set): 8 +, 21 *, 1 /
+ *      equations of motion:  26 +, 40 *, expression trees 122 +, 196 *, 9 /
+ *      transformation m:     12 +, 18 *, expression trees 12 +, 27 *
+ *      linearization A, B:   39 +, 64 *, expression trees 297 +, 555 *, 36 /
+ *
+ * =====================================================================================
+ */
+
+#ifndef  RIGIDBODYKERNELS_HPP
+#define  RIGIDBODYKERNELS_HPP
+
+#include <array>
+
+namespace rigidbody {
+
+using KernelConstants = std::array<double, 8>;
+
+// P is any type with members Ixx, Iyy, Izz, Ixy, Iyz, Ixz
+template <class P>
+constexpr void evalConstants(const P & p, KernelConstants & c) noexcept
+{
+  const double z0 = p.Iyy*p.Izz - p.Iyz*p.Iyz;
+  const double z1 = p.Izz*p.Ixy - p.Iyz*p.Ixz;
+  const double z2 = p.Ixy*p.Iyz - p.Iyy*p.Ixz;
+  const double z3 = 1.0/(p.Ixx*z0 + p.Ixz*z2 - p.Ixy*z1);
+  const double z4 = z1*z3;
+  const double z5 = (p.Ixx*p.Iyz - p.Ixy*p.Ixz)*z3;
+  c[0] = z0*z3;
+  c[1] = z4;
+  c[2] = z2*z3;
+  c[3] = (p.Ixx*p.Izz - p.Ixz*p.Ixz)*z3;
+  c[4] = z5;
+  c[5] = (p.Ixx*p.Iyy - p.Ixy*p.Ixy)*z3;
+  c[6] = -z4;
+  c[7] = -z5;
+}
+
+// state ordering:  [e0, e1, e2, e3, u0, u1, u2]
+template <class P>
+constexpr void evalEoms(const P & p, const KernelConstants & c,
+                        const std::array<double, 7> & x, std::array<double, 7> & f) noexcept
+{
+  const double e0 = x[0];
+  const double e1 = x[1];
+  const double e2 = x[2];
+  const double e3 = x[3];
+  const double u0 = x[4];
+  const double u1 = x[5];
+  const double u2 = x[6];
+  const double z0 = p.Ixz*u0 + p.Iyz*u1 + p.Izz*u2;
+  const double z1 = p.Ixy*u0 + p.Iyy*u1 + p.Iyz*u2;
+  const double z2 = p.Tax - (u1*z0 - u2*z1);
+  const double z3 = p.Ixx*u0 + p.Ixy*u1 + p.Ixz*u2;
+  const double z4 = p.Tay - (u2*z3 - u0*z0);
+  const double z5 = p.Taz - (u0*z1 - u1*z3);
+  f[0] = 0.5*(e1*u2 + e3*u0 - e2*u1);
+  f[1] = 0.5*(e2*u0 + e3*u1 - e0*u2);
+  f[2] = 0.5*(e0*u1 + e3*u2 - e1*u0);
+  f[3] = -0.5*(e0*u0 + e1*u1 + e2*u2);
+  f[4] = z2*c[0] + z5*c[2] - z4*c[1];
+  f[5] = z4*c[3] - z2*c[1] - z5*c[4];
+  f[6] = z2*c[2] + z5*c[5] - z4*c[4];
+}
+
+// 4x4 transformation matrix, column-major format as used by OpenGL
+constexpr void evalTransform(const std::array<double, 7> & x, std::array<double, 16> & m) noexcept
+{
+  const double e0 = x[0];
+  const double e1 = x[1];
+  const double e2 = x[2];
+  const double e3 = x[3];
+  const double z0 = e1*e1;
+  const double z1 = e2*e2;
+  const double z2 = e0*e1;
+  const double z3 = e2*e3;
+  const double z4 = e0*e2;
+  const double z5 = e1*e3;
+  const double z6 = e0*e0;
+  const double z7 = e1*e2;
+  const double z8 = e0*e3;
+  m[0] = 1.0 - 2.0*(z0 + z1);
+  m[1] = 2.0*(z2 + z3);
+  m[2] = 2.0*(z4 - z5);
+  m[3] = 0.0;
+  m[4] = 2.0*(z2 - z3);
+  m[5] = 1.0 - 2.0*(z1 + z6);
+  m[6] = 2.0*(z7 + z8);
+  m[7] = 0.0;
+  m[8] = 2.0*(z4 + z5);
+  m[9] = 2.0*(z7 - z8);
+  m[10] = 1.0 - 2.0*(z0 + z6);
+  m[11] = 0.0;
+  m[12] = 0.0;
+  m[13] = 0.0;
+  m[14] = 0.0;
+  m[15] = 1.0;
+}
+
+// A = df/dx and B = df/du, row-major
+template <class P>
+constexpr void evalLinearization(const P & p, const KernelConstants & c,
+                                 const std::array<double, 7> & x,
+                                 std::array<double, 49> & A, std::array<double, 21> & B) noexcept
+{
+  const double e0 = x[0];
+  const double e1 = x[1];
+  const double e2 = x[2];
+  const double e3 = x[3];
+  const double u0 = x[4];
+  const double u1 = x[5];
+  const double u2 = x[6];
+  const double z0 = 0.5*u2;
+  const double z1 = -0.5*u1;
+  const double z2 = 0.5*u0;
+  const double z3 = 0.5*e3;
+  const double z4 = -0.5*e2;
+  const double z5 = -0.5*u2;
+  const double z6 = 0.5*u1;
+  const double z7 = -0.5*e0;
+  const double z8 = -0.5*u0;
+  const double z9 = -0.5*e1;
+  const double z10 = p.Ixz*u1;
+  const double z11 = p.Ixy*u2;
+  const double z12 = z10 - z11;
+  const double z13 = p.Ixz*u0;
+  const double z14 = p.Iyz*u1;
+  const double z15 = p.Izz*u2;
+  const double z16 = p.Ixx*u2 - (2.0*z13 + z14 + z15);
+  const double z17 = p.Ixy*u0;
+  const double z18 = p.Iyy*u1;
+  const double z19 = p.Iyz*u2;
+  const double z20 = 2.0*z17 + z18 + z19 - p.Ixx*u1;
+  const double z21 = z13 + 2.0*z14 + z15 - p.Iyy*u2;
+  const double z22 = p.Iyz*u0;
+  const double z23 = z11 - z22;
+  const double z24 = p.Ixx*u0;
+  const double z25 = p.Ixy*u1;
+  const double z26 = p.Ixz*u2;
+  const double z27 = p.Iyy*u0 - (z24 + 2.0*z25 + z26);
+  const double z28 = p.Izz*u1 - (z17 + z18 + 2.0*z19);
+  const double z29 = z24 + z25 + 2.0*z26 - p.Izz*u0;
+  const double z30 = z22 - z10;
+  A[0] = 0.0;
+  A[1] = z0;
+  A[2] = z1;
+  A[3] = z2;
+  A[4] = z3;
+  A[5] = z4;
+  A[6] = 0.5*e1;
+  A[7] = z5;
+  A[8] = 0.0;
+  A[9] = z2;
+  A[10] = z6;
+  A[11] = 0.5*e2;
+  A[12] = z3;
+  A[13] = z7;
+  A[14] = z6;
+  A[15] = z8;
+  A[16] = 0.0;
+  A[17] = z0;
+  A[18] = z9;
+  A[19] = 0.5*e0;
+  A[20] = z3;
+  A[21] = z8;
+  A[22] = z1;
+  A[23] = z5;
+  A[24] = 0.0;
+  A[25] = z7;
+  A[26] = z9;
+  A[27] = z4;
+  A[28] = 0.0;
+  A[29] = 0.0;
+  A[30] = 0.0;
+  A[31] = 0.0;
+  A[32] = c[1]*z16 - c[0]*z12 - c[2]*z20;
+  A[33] = c[1]*z23 - c[0]*z21 - c[2]*z27;
+  A[34] = c[1]*z29 - c[0]*z28 - c[2]*z30;
+  A[35] = 0.0;
+  A[36] = 0.0;
+  A[37] = 0.0;
+  A[38] = 0.0;
+  A[39] = c[1]*z12 + c[4]*z20 - c[3]*z16;
+  A[40] = c[1]*z21 + c[4]*z27 - c[3]*z23;
+  A[41] = c[1]*z28 + c[4]*z30 - c[3]*z29;
+  A[42] = 0.0;
+  A[43] = 0.0;
+  A[44] = 0.0;
+  A[45] = 0.0;
+  A[46] = c[4]*z16 - c[2]*z12 - c[5]*z20;
+  A[47] = c[4]*z23 - c[2]*z21 - c[5]*z27;
+  A[48] = c[4]*z29 - c[2]*z28 - c[5]*z30;
+  B[0] = 0.0;
+  B[1] = 0.0;
+  B[2] = 0.0;
+  B[3] = 0.0;
+  B[4] = 0.0;
+  B[5] = 0.0;
+  B[6] = 0.0;
+  B[7] = 0.0;
+  B[8] = 0.0;
+  B[9] = 0.0;
+  B[10] = 0.0;
+  B[11] = 0.0;
+  B[12] = c[0];
+  B[13] = c[6];
+  B[14] = c[2];
+  B[15] = c[6];
+  B[16] = c[3];
+  B[17] = c[7];
+  B[18] = c[2];
+  B[19] = c[7];
+  B[20] = c[5];
+}
+
+} // namespace rigidbody
+
+#endif   /* ----- #ifndef RIGIDBODYKERNELS_HPP ----- */
@@ -0,0 +1,55 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  rigidbodyshim.cpp
+ *
+ *    Description:  extern "C" wrappers around the generated kernels in
+ *    rigidbodykernels.hpp, see rigidbodyshim.h.
+ *
+ * =====================================================================================
+ */
+
+#include <algorithm>
+
+#include "rigidbodycore.hpp"
+#include "rigidbodyshim.h"
+
+using namespace rigidbody;
+
+static_assert(std::tuple_size<KernelConstants>::value == RIGIDBODY_CONSTANTS,
+              "RIGIDBODY_CONSTANTS is out of date with rigidbodykernels.hpp");
+
+void rigidbodyConstants(const RigidBodyParameters * p, double c[RIGIDBODY_CONSTANTS])
+{
+  KernelConstants k;
+  evalConstants(*p, k);
+  std::copy(k.begin(), k.end(), c);
+} // rigidbodyConstants()
+
+void rigidbodyEoms(const RigidBodyParameters * p, const double c[RIGIDBODY_CONSTANTS],
+                   const double x[7], double f[7])
+{
+  KernelConstants k;
+  State xs, fs;
+  std::copy(c, c + k.size(), k.begin());
+  std::copy(x, x + xs.size(), xs.begin());
+  evalEoms(*p, k, xs, fs);
+  std::copy(fs.begin(), fs.end(), f);
+} // rigidbodyEoms()
+
+void rigidbodyOutputs(const RigidBodyParameters * p, const double c[RIGIDBODY_CONSTANTS],
+                      const double x[7], double m[16], double A[49], double B[21])
+{
+  KernelConstants k;
+  State xs;
+  Transform ms;
+  std::array<double, 49> As;
+  std::array<double, 21> Bs;
+  std::copy(c, c + k.size(), k.begin());
+  std::copy(x, x + xs.size(), xs.begin());
+  evalTransform(xs, ms);
+  evalLinearization(*p, k, xs, As, Bs);
+  std::copy(ms.begin(), ms.end(), m);
+  std::copy(As.begin(), As.end(), A);
+  std::copy(Bs.begin(), Bs.end(), B);
+} // rigidbodyOutputs()
@@ -0,0 +1,44 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  rigidbodyshim.h
+ *
+ *    Description:  C interface to the kernels used by rigidbodycore.hpp, so
+ *    that eoms() and evalOutputs() in rigidbodyeoms.c evaluate the same
+ *    generated equations as the C++ programs.
+ *
+ * =====================================================================================
+ */
+
+#ifndef  RIGIDBODYSHIM_H
+#define  RIGIDBODYSHIM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Number of parameter-only subexpressions computed by rigidbodyConstants()
+#define RIGIDBODY_CONSTANTS 8
+
+// Mass properties and applied torques, same members as rigidbody::Parameters
+typedef struct {
+  double Ixx, Iyy, Izz, Ixy, Iyz, Ixz;
+  double Tax, Tay, Taz;
+} RigidBodyParameters;
+
+// Must be called again whenever the mass properties change
+void rigidbodyConstants(const RigidBodyParameters * p, double c[RIGIDBODY_CONSTANTS]);
+
+// state ordering:  [e0, e1, e2, e3, u0, u1, u2]
+void rigidbodyEoms(const RigidBodyParameters * p, const double c[RIGIDBODY_CONSTANTS],
+                   const double x[7], double f[7]);
+
+// 4x4 transformation matrix m (column-major, OpenGL), A and B (row-major)
+void rigidbodyOutputs(const RigidBodyParameters * p, const double c[RIGIDBODY_CONSTANTS],
+                      const double x[7], double m[16], double A[49], double B[21]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   /* ----- #ifndef RIGIDBODYSHIM_H ----- */
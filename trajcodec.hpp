@@ -0,0 +1,566 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  trajcodec.hpp
+ *
+ *    Description:  Compact trajectory format for states sampled at a fixed
+ *    output rate.  Euler parameters are stored with smallest-three
+ *    quantization in a configurable number of bits, angular velocities are
+ *    quantized, delta coded and written as zigzag varints.  Samples are
+ *    grouped in blocks that start from absolute values and are listed in an
+ *    index at the end of the file, so any block can be decoded on its own.
+ *    The transformation matrix is not stored, transform() recovers it from
+ *    the decoded Euler parameters.
+ *
+ *    Layout, all integers little endian:
+ *
+ *      header   "EPTC" u8 version, u8 qbits, u16 block size,
+ *               f64 t0, f64 dt, f64 rate quantum
+ *      blocks   varint n, n packed quaternions of ceil((2 + 3 qbits)/8)
+ *               bytes each, 3 n zigzag varint rate deltas
+ *      index    u64 byte offset of each block
+ *      footer   u64 sample count, u64 index offset, "EPTC"
+ *
+ * =====================================================================================
+ */
+
+#ifndef  TRAJCODEC_HPP
+#define  TRAJCODEC_HPP
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "rigidbodycore.hpp"
+
+namespace rigidbody {
+
+namespace trajcodec {
+
+constexpr std::uint8_t magic[4] = {'E', 'P', 'T', 'C'};
+constexpr std::uint8_t version = 2;
+constexpr std::size_t headerSize = 4 + 1 + 1 + 2 + 3*8;
+constexpr std::size_t footerSize = 8 + 8 + 4;
+constexpr int minBits = 4, maxBits = 20;
+
+// Smallest three components lie in [-1/sqrt(2), 1/sqrt(2)]
+constexpr double range = 0.70710678118654752440;
+
+constexpr std::size_t packedSize(int qbits) noexcept { return (2 + 3*qbits + 7)/8; }
+
+// Largest stored code, the grid has an odd number of levels so that 0 is
+// one of them
+constexpr std::uint64_t maxCode(int qbits) noexcept { return ((std::uint64_t) 1 << qbits) - 2; }
+
+// Quantization step of the three stored Euler parameters
+constexpr double quaternionStep(int qbits) noexcept
+{
+  return 2.0*range/maxCode(qbits);
+}
+
+// A priori bound on the rotation angle between original and decoded
+// orientation.  Each stored component is off by at most d = step/2.  The
+// largest component a >= 1/2 is recovered from the unit norm, and since the
+// others sum to at most 3/2 in magnitude, |a - a'| <= d (3 + 3 d)/(a + a')
+// <= 6 d (1 + d).  The angle is 4 asin(|q - q'|/2).
+inline double quaternionBound(int qbits) noexcept
+{
+  const double d = 0.5*quaternionStep(qbits), da = 6.0*d*(1.0 + d);
+  const double chord = std::sqrt(3.0*d*d + da*da);
+  return 4.0*std::asin(chord < 2.0 ? 0.5*chord : 1.0);
+}
+
+// Rates are coded losslessly after rounding to the quantum
+constexpr double rateBound(double quantum) noexcept { return 0.5*quantum; }
+
+// The put functions write at p and return the end of what they wrote
+inline std::uint8_t * putU64(std::uint8_t * p, std::uint64_t v, int bytes = 8) noexcept
+{
+  for (int i = 0; i < bytes; ++i)
+    p[i] = (std::uint8_t) (v >> 8*i);
+  return p + bytes;
+}
+
+inline std::uint64_t getU64(const std::uint8_t * p, int bytes = 8) noexcept
+{
+  std::uint64_t v = 0;
+  for (int i = 0; i < bytes; ++i)
+    v |= (std::uint64_t) p[i] << 8*i;
+  return v;
+}
+
+inline std::uint8_t * putF64(std::uint8_t * p, double x) noexcept
+{
+  std::uint64_t v;
+  std::memcpy(&v, &x, sizeof v);
+  return putU64(p, v);
+}
+
+inline double getF64(const std::uint8_t * p) noexcept
+{
+  std::uint64_t v = getU64(p);
+  double x;
+  std::memcpy(&x, &v, sizeof x);
+  return x;
+}
+
+// At most 10 bytes
+inline std::uint8_t * putVarint(std::uint8_t * p, std::uint64_t v) noexcept
+{
+  while (v >= 0x80) {
+    *p++ = (std::uint8_t) (v | 0x80);
+    v >>= 7;
+  }
+  *p++ = (std::uint8_t) v;
+  return p;
+}
+
+// Returns the number of bytes consumed, 0 if the varint runs past end
+inline std::size_t getVarint(const std::uint8_t * p, const std::uint8_t * end,
+                             std::uint64_t & v) noexcept
+{
+  v = 0;
+  for (std::size_t i = 0; p + i < end && i < 10; ++i) {
+    v |= (std::uint64_t) (p[i] & 0x7f) << 7*i;
+    if (!(p[i] & 0x80))
+      return i + 1;
+  }
+  return 0;
+}
+
+constexpr std::uint64_t zigzag(std::int64_t v) noexcept
+{
+  return ((std::uint64_t) v << 1) ^ (std::uint64_t) (v >> 63);
+}
+
+constexpr std::int64_t unzigzag(std::uint64_t v) noexcept
+{
+  return (std::int64_t) (v >> 1) ^ -(std::int64_t) (v & 1);
+}
+
+} // namespace trajcodec
+
+// Accumulates samples and encodes them a block at a time into a 64 KiB
+// buffer that is written to a file whenever it fills; only the block
+// offsets are kept for the whole trajectory.  Quantization runs over
+// structure-of-arrays copies of the block in branch-free loops that GCC
+// vectorizes given -fno-math-errno (without it std::sqrt keeps a branch for
+// errno); only the bit packing and varint coding are sequential.
+class TrajectoryWriter {
+ public:
+  // qbits is clamped to [4, 20]; t0 and dt give the time of each sample.
+  // rateQuantum must be positive and finite, otherwise status() is Invalid
+  // and nothing is written.
+  TrajectoryWriter(FILE * fp, int qbits, double rateQuantum, std::size_t blockSize,
+                   double t0, double dt)
+    : fp_(fp),
+      qbits_(qbits < trajcodec::minBits ? trajcodec::minBits
+             : qbits > trajcodec::maxBits ? trajcodec::maxBits : qbits),
+      blockSize_(blockSize < 1 ? 1 : blockSize > 0xffff ? 0xffff : blockSize),
+      rateQuantum_(rateQuantum),
+      e_(4*blockSize_), w_(3*blockSize_), r_(3*blockSize_), tmp_(blockSize_),
+      code_(4*blockSize_)
+  {
+    if (!(rateQuantum > 0.0) || !std::isfinite(rateQuantum)) {
+      status_ = Invalid;
+      return;
+    }
+    buf_.resize(64*1024);
+    std::uint8_t * p = reserve(trajcodec::headerSize);
+    std::memcpy(p, trajcodec::magic, 4);
+    p[4] = trajcodec::version;
+    p[5] = (std::uint8_t) qbits_;
+    p = trajcodec::putU64(p + 6, blockSize_, 2);
+    p = trajcodec::putF64(p, t0);
+    p = trajcodec::putF64(p, dt);
+    p = trajcodec::putF64(p, rateQuantum_);
+    commit(p);
+  }
+
+  void add(const State & x)
+  {
+    if (status_ != Success)
+      return;
+    for (std::size_t i = 0; i < 4; ++i)
+      e_[i*blockSize_ + n_] = x[i];
+    for (std::size_t i = 0; i < 3; ++i)
+      w_[i*blockSize_ + n_] = x[4 + i];
+    if (++n_ == blockSize_)
+      flush();
+  }
+
+  // Write the last partial block, index and footer.  Returns Success,
+  // Invalid for a bad rate quantum or Failure if a write failed.
+  int finish()
+  {
+    if (status_ != Success)
+      return status_;
+    if (n_ > 0)
+      flush();
+    const std::uint64_t indexOffset = bytes_;
+    std::uint8_t * p = reserve(8*offsets_.size() + trajcodec::footerSize);
+    for (std::uint64_t offset : offsets_)
+      p = trajcodec::putU64(p, offset);
+    p = trajcodec::putU64(p, samples_);
+    p = trajcodec::putU64(p, indexOffset);
+    std::memcpy(p, trajcodec::magic, 4);
+    commit(p + 4);
+    drain();
+    return status_;
+  }
+
+  int status() const noexcept { return status_; }
+  // Bytes written so far
+  std::uint64_t bytes() const noexcept { return bytes_; }
+  int qbits() const noexcept { return qbits_; }
+  // A priori bounds on reconstruction error, rotation angle and rates
+  double quaternionBound() const noexcept { return trajcodec::quaternionBound(qbits_); }
+  double rateBound() const noexcept { return trajcodec::rateBound(rateQuantum_); }
+  // Largest errors actually incurred by the samples written so far
+  double maxQuaternionError() const noexcept { return maxAngle_; }
+  double maxRateError() const noexcept { return maxRate_; }
+
+ private:
+  // Encoded bytes collect in buf_ and go to the file in large writes.
+  // reserve() returns room for size more bytes, commit() marks them used up
+  // to end.
+  std::uint8_t * reserve(std::size_t size)
+  {
+    if (used_ + size > buf_.size()) {
+      drain();
+      if (size > buf_.size())
+        buf_.resize(size);
+    }
+    return buf_.data() + used_;
+  }
+
+  void commit(const std::uint8_t * end) noexcept
+  {
+    const std::size_t size = end - (buf_.data() + used_);
+    used_ += size;
+    bytes_ += size;
+  }
+
+  void drain()
+  {
+    if (used_ > 0 && fwrite(buf_.data(), 1, used_, fp_) != used_)
+      status_ = Failure;
+    used_ = 0;
+  }
+
+  // Out of line: inlined where qbits is a constant, GCC no longer
+  // if-converts the quantization loop and leaves it scalar.
+  [[gnu::noinline]] void flush()
+  {
+    using namespace trajcodec;
+    const std::size_t B = blockSize_, n = n_;
+    const double * e0 = &e_[0], * e1 = &e_[B], * e2 = &e_[2*B], * e3 = &e_[3*B];
+    double * tmp = &tmp_[0];
+    double * big = &code_[0], * q0 = &code_[B], * q1 = &code_[2*B], * q2 = &code_[3*B];
+    // Adding and subtracting 1.5 2^52 rounds to the nearest integer for
+    // magnitudes below 2^51
+    const double round = 6755399441055744.0;
+    const double top = (double) maxCode(qbits_), scale = top/(2.0*range);
+    const double step = quaternionStep(qbits_);
+
+    // Smallest three quantization, the largest component is made positive.
+    // The largest component is picked and the other three shifted into place
+    // with selects rather than indexing, and the squared chord between
+    // original and decoded unit quaternion is kept for the error measure.
+    // The arrays never overlap, ivdep saves GCC from giving up on the
+    // number of run-time alias checks it would otherwise need.
+#pragma GCC ivdep
+    for (std::size_t k = 0; k < n; ++k) {
+      const double a0 = e0[k], a1 = e1[k], a2 = e2[k], a3 = e3[k];
+      const double f0 = std::fabs(a0), f1 = std::fabs(a1), f2 = std::fabs(a2), f3 = std::fabs(a3);
+      const bool b1 = f1 > f0;
+      const double m1 = b1 ? f1 : f0, s1 = b1 ? a1 : a0, i1 = b1 ? 1.0 : 0.0;
+      const bool b2 = f2 > m1;
+      const double m2 = b2 ? f2 : m1, s2 = b2 ? a2 : s1, i2 = b2 ? 2.0 : i1;
+      const bool b3 = f3 > m2;
+      const double m3 = b3 ? f3 : m2, s3 = b3 ? a3 : s2, ib = b3 ? 3.0 : i2;
+      const double inv = 1.0/std::sqrt(a0*a0 + a1*a1 + a2*a2 + a3*a3);
+      const double s = std::copysign(inv, s3);
+      // Component j of the stored three is q[j] below big and q[j + 1] above
+      const double x0 = (ib < 0.5 ? a1 : a0)*s;
+      const double x1 = (ib < 1.5 ? a2 : a1)*s;
+      const double x2 = (ib < 2.5 ? a3 : a2)*s;
+      // Round, then clamp to the grid.  Codes stay in doubles, exact, and
+      // every operation is unconditional: anything evaluated on one side of
+      // a select would keep the loop from being if-converted.
+      double k0 = ((x0 + range)*scale + round) - round;
+      double k1 = ((x1 + range)*scale + round) - round;
+      double k2 = ((x2 + range)*scale + round) - round;
+      k0 = k0 > 0.0 ? k0 : 0.0;
+      k1 = k1 > 0.0 ? k1 : 0.0;
+      k2 = k2 > 0.0 ? k2 : 0.0;
+      k0 = k0 < top ? k0 : top;
+      k1 = k1 < top ? k1 : top;
+      k2 = k2 < top ? k2 : top;
+      // Reconstruct as TrajectoryReader does
+      const double d0 = k0*step - range, d1 = k1*step - range, d2 = k2*step - range;
+      const double sum = d0*d0 + d1*d1 + d2*d2;
+      double rest = 1.0 - sum;
+      rest = rest > 0.0 ? rest : 0.0;
+      // sum + rest is sum when sum > 1 and 1 to within rounding otherwise
+      const double nq = 1.0/std::sqrt(sum + rest);
+      const double g0 = d0*nq - x0, g1 = d1*nq - x1, g2 = d2*nq - x2;
+      const double gb = std::sqrt(rest)*nq - m3*inv;
+      big[k] = ib;
+      q0[k] = k0;
+      q1[k] = k1;
+      q2[k] = k2;
+      tmp[k] = g0*g0 + g1*g1 + g2*g2 + gb*gb;
+    }
+    // The rotation angle 4 asin(chord/2) grows with the chord, so only the
+    // largest chord of the block needs converting
+    double chord = 0.0;
+    for (std::size_t k = 0; k < n; ++k)
+      chord = tmp[k] > chord ? tmp[k] : chord;
+    chord = std::sqrt(chord);
+    const double angle = 4.0*std::asin(chord < 2.0 ? 0.5*chord : 1.0);
+    maxAngle_ = angle > maxAngle_ ? angle : maxAngle_;
+
+    // Rate quantization and delta coding, first sample of a block is
+    // relative to zero.  |w/quantum| is clamped to 2^50 after rounding, so
+    // the rounded values and their deltas are exact in doubles and fit an
+    // int64.
+    const double invq = 1.0/rateQuantum_, lim = 1125899906842624.0;
+    double maxRate = maxRate_;
+    for (std::size_t i = 0; i < 3; ++i) {
+      const double * w = &w_[i*B];
+      double * dw = &r_[i*B], * err = tmp;
+      for (std::size_t k = 0; k < n; ++k) {
+        double y = (w[k]*invq + round) - round;
+        y = y > -lim ? y : -lim;
+        y = y < lim ? y : lim;
+        dw[k] = y;
+        err[k] = std::fabs(y*rateQuantum_ - w[k]);
+      }
+      for (std::size_t k = 0; k < n; ++k)
+        maxRate = err[k] > maxRate ? err[k] : maxRate;
+      for (std::size_t k = n - 1; k > 0; --k)
+        dw[k] -= dw[k - 1];
+    }
+    maxRate_ = maxRate;
+
+    offsets_.push_back(bytes_);
+    std::uint8_t * p = putVarint(reserve(10 + n*(packedSize(qbits_) + 3*10)), n);
+    const int bytes = (int) packedSize(qbits_);
+    // Each code is stored as a whole word and the next one overwrites its
+    // unused top bytes; the rates reserved after the codes leave room for
+    // the last.  Codes are non-negative, converting them as signed is a
+    // single instruction.
+    for (std::size_t k = 0; k < n; ++k) {
+      putU64(p, (std::uint64_t) (std::int64_t) big[k]
+             | (std::uint64_t) (std::int64_t) q0[k] << 2
+             | (std::uint64_t) (std::int64_t) q1[k] << (2 + qbits_)
+             | (std::uint64_t) (std::int64_t) q2[k] << (2 + 2*qbits_));
+      p += bytes;
+    }
+    for (std::size_t k = 0; k < n; ++k)
+      for (std::size_t i = 0; i < 3; ++i)
+        p = putVarint(p, zigzag((std::int64_t) r_[i*B + k]));
+    commit(p);
+
+    samples_ += n;
+    n_ = 0;
+  } // flush()
+
+  FILE * fp_;
+  int qbits_;
+  std::size_t blockSize_;
+  double rateQuantum_;
+  std::vector<double> e_, w_, r_, tmp_;
+  std::vector<double> code_;
+  std::vector<std::uint8_t> buf_;
+  std::vector<std::uint64_t> offsets_;
+  std::size_t n_ = 0, samples_ = 0, used_ = 0;
+  std::uint64_t bytes_ = 0;
+  double maxAngle_ = 0.0, maxRate_ = 0.0;
+  int status_ = Success;
+};
+
+// Random access decoding of an encoded trajectory file.  Only the header,
+// footer and block index are read when opening; readBlock() seeks to a
+// block and reads just its bytes, so memory use and I/O follow the range
+// of samples wanted rather than the length of the file.
+class TrajectoryReader {
+ public:
+  // Check header, footer and index.  Returns Success, Invalid if the file
+  // is not a valid trajectory or Failure if it could not be read.
+  int open(FILE * fp)
+  {
+    using namespace trajcodec;
+    fp_ = fp;
+    std::uint8_t h[headerSize], f[footerSize];
+    if (fseeko(fp, 0, SEEK_END) != 0)
+      return Failure;
+    const off_t size = ftello(fp);
+    if (size < 0)
+      return Failure;
+    if ((std::uint64_t) size < headerSize + footerSize)
+      return Invalid;
+    if (!readAt(0, h, headerSize) || !readAt(size - footerSize, f, footerSize))
+      return Failure;
+    if (std::memcmp(h, magic, 4) != 0 || std::memcmp(f + 16, magic, 4) != 0
+        || h[4] != version)
+      return Invalid;
+    qbits_ = h[5];
+    blockSize_ = (std::size_t) getU64(h + 6, 2);
+    t0_ = getF64(h + 8);
+    dt_ = getF64(h + 16);
+    rateQuantum_ = getF64(h + 24);
+    samples_ = getU64(f);
+    index_ = getU64(f + 8);
+    const std::uint64_t indexEnd = size - footerSize;
+    if (qbits_ < minBits || qbits_ > maxBits || blockSize_ == 0
+        || index_ < headerSize || index_ > indexEnd)
+      return Invalid;
+    blocks_ = (samples_ + blockSize_ - 1)/blockSize_;
+    if ((indexEnd - index_) % 8 != 0 || (indexEnd - index_)/8 != blocks_)
+      return Invalid;
+
+    // Offsets must increase, each block extends to the next one and can't
+    // be longer than blockSize() samples take at most
+    std::vector<std::uint8_t> index(indexEnd - index_);
+    if (!readAt(index_, index.data(), index.size()))
+      return Failure;
+    offsets_.resize(blocks_ + 1);
+    for (std::size_t b = 0; b < blocks_; ++b)
+      offsets_[b] = getU64(&index[8*b]);
+    offsets_[blocks_] = index_;
+    const std::uint64_t longest = 10 + blockSize_*(packedSize(qbits_) + 3*10);
+    if (blocks_ > 0 && offsets_[0] < headerSize)
+      return Invalid;
+    for (std::size_t b = 0; b < blocks_; ++b)
+      if (offsets_[b] >= offsets_[b + 1] || offsets_[b + 1] - offsets_[b] > longest)
+        return Invalid;
+    code_.assign(4*blockSize_, 0.0);
+    return Success;
+  } // open()
+
+  std::size_t samples() const noexcept { return samples_; }
+  std::size_t blocks() const noexcept { return blocks_; }
+  std::size_t blockSize() const noexcept { return blockSize_; }
+  int qbits() const noexcept { return qbits_; }
+  double rateQuantum() const noexcept { return rateQuantum_; }
+  double time(std::size_t k) const noexcept { return t0_ + k*dt_; }
+
+  // Decode block b into out[0..n), out must hold blockSize() states.  Every
+  // block but the last holds exactly blockSize() samples.  Returns Success,
+  // Invalid for a corrupt block or Failure if it could not be read.
+  int readBlock(std::size_t b, State * out, std::size_t & n)
+  {
+    using namespace trajcodec;
+    if (b >= blocks_)
+      return Invalid;
+    // 8 bytes of padding after the block for the word reads of
+    // decodeQuaternions()
+    const std::size_t size = offsets_[b + 1] - offsets_[b];
+    block_.resize(size + 8);
+    if (!readAt(offsets_[b], block_.data(), size))
+      return Failure;
+    const std::uint8_t * p = block_.data(), * end = p + size;
+    std::uint64_t v;
+    std::size_t used = getVarint(p, end, v);
+    const std::size_t expected = b + 1 < blocks_ ? blockSize_ : samples_ - b*blockSize_;
+    if (used == 0 || v != expected)
+      return Invalid;
+    n = (std::size_t) v;
+    p += used;
+
+    const std::size_t bytes = packedSize(qbits_);
+    if ((std::size_t) (end - p) < n*bytes)
+      return Invalid;
+    if (!decodeQuaternions(p, out, n))
+      return Invalid;
+    p += n*bytes;
+
+    std::int64_t w[3] = {0, 0, 0};
+    for (std::size_t k = 0; k < n; ++k)
+      for (std::size_t i = 0; i < 3; ++i) {
+        used = getVarint(p, end, v);
+        if (used == 0)
+          return Invalid;
+        p += used;
+        w[i] += unzigzag(v);
+        out[k][4 + i] = w[i]*rateQuantum_;
+      }
+    return p == end ? Success : Invalid;
+  } // readBlock()
+
+ private:
+  // The mirror image of TrajectoryWriter::flush(): the bit fields are
+  // extracted sequentially into structure-of-arrays codes, the Euler
+  // parameters are reconstructed from them in a branch-free loop that GCC
+  // vectorizes given -fno-math-errno, and codes off the grid are caught by
+  // an OR over the whole block rather than a test per sample.  Returns
+  // false if there were any.
+  bool decodeQuaternions(const std::uint8_t * p, State * out, std::size_t n) noexcept
+  {
+    using namespace trajcodec;
+    const std::size_t B = blockSize_, bytes = packedSize(qbits_);
+    const std::uint64_t mask = ((std::uint64_t) 1 << qbits_) - 1, top = maxCode(qbits_);
+    double * big = &code_[0], * q0 = &code_[B], * q1 = &code_[2*B], * q2 = &code_[3*B];
+    std::uint64_t bad = 0;
+    for (std::size_t k = 0; k < n; ++k, p += bytes) {
+      // A whole 8 byte word is read and the fields masked out of it.  At
+      // most 7 bytes past the quaternions are touched, readBlock() pads the
+      // block for them.
+      const std::uint64_t bits = getU64(p);
+      const std::uint64_t k0 = (bits >> 2) & mask, k1 = (bits >> (2 + qbits_)) & mask;
+      const std::uint64_t k2 = (bits >> (2 + 2*qbits_)) & mask;
+      bad |= (k0 > top) | (k1 > top) | (k2 > top);
+      big[k] = (double) (std::int64_t) (bits & 3);
+      q0[k] = (double) (std::int64_t) k0;
+      q1[k] = (double) (std::int64_t) k1;
+      q2[k] = (double) (std::int64_t) k2;
+    }
+
+    // Same arithmetic as the writer uses to measure its error.  The largest
+    // component follows from the unit norm; when rounding takes the three
+    // stored ones past it, it is 0 and the quaternion is renormalized.
+    const double step = quaternionStep(qbits_);
+#pragma GCC ivdep
+    for (std::size_t k = 0; k < n; ++k) {
+      const double ib = big[k];
+      const double d0 = q0[k]*step - range, d1 = q1[k]*step - range, d2 = q2[k]*step - range;
+      const double sum = d0*d0 + d1*d1 + d2*d2;
+      double rest = 1.0 - sum;
+      rest = rest > 0.0 ? rest : 0.0;
+      // sum + rest is sum when sum > 1 and 1 to within rounding otherwise
+      const double nq = 1.0/std::sqrt(sum + rest);
+      const double x0 = d0*nq, x1 = d1*nq, x2 = d2*nq, xb = std::sqrt(rest)*nq;
+      // Stored component j is q[j] below big and q[j + 1] above
+      const double y1 = ib < 0.5 ? x0 : x1, y2 = ib < 1.5 ? x1 : x2;
+      out[k][0] = ib < 0.5 ? xb : x0;
+      out[k][1] = ib > 0.5 && ib < 1.5 ? xb : y1;
+      out[k][2] = ib > 1.5 && ib < 2.5 ? xb : y2;
+      out[k][3] = ib > 2.5 ? xb : x2;
+    }
+    return bad == 0;
+  } // decodeQuaternions()
+
+  bool readAt(std::uint64_t offset, std::uint8_t * p, std::size_t size)
+  {
+    return fseeko(fp_, (off_t) offset, SEEK_SET) == 0 && fread(p, 1, size, fp_) == size;
+  }
+
+  FILE * fp_ = nullptr;
+  std::size_t blockSize_ = 0, samples_ = 0, blocks_ = 0;
+  std::uint64_t index_ = 0;
+  // Byte offset of each block, followed by that of the index
+  std::vector<std::uint64_t> offsets_;
+  std::vector<std::uint8_t> block_;
+  int qbits_ = 0;
+  double t0_ = 0.0, dt_ = 0.0, rateQuantum_ = 0.0;
+  std::vector<double> code_;
+};
+
+} // namespace rigidbody
+
+#endif   /* ----- #ifndef TRAJCODEC_HPP ----- */
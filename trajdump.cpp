@@ -0,0 +1,101 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  trajdump.cpp
+ *
+ *    Description:  Decode a compressed trajectory written by integrate --out,
+ *    printing time, Euler parameters and angular velocity for each sample.
+ *    Only the header, block index and the blocks covering the requested
+ *    range of samples are read from the file.
+ *
+ * =====================================================================================
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "trajcodec.hpp"
+
+using namespace rigidbody;
+
+int main(int argc, char ** argv)
+{
+  long from = 0, to = -1;
+  int c, opt_index;
+  struct option long_options[] = {
+     {"help", no_argument, 0, '?'},
+     {"from",  required_argument, 0, 'f'},
+     {"to",  required_argument, 0, 't'},
+     {0, 0, 0, 0} };
+  while (1) {
+    opt_index = 0;
+    c = getopt_long(argc, argv, "?f:t:", long_options, &opt_index);
+
+  if (c == -1)
+    break;
+
+  switch (c) {
+    case '?':
+      printf(
+"usage: %s [OPTION] file\n\n"
+"  -?, --help                   Display this help and exit.\n"
+"  -f val, --from=val           First sample to print (0)\n"
+"  -t val, --to=val             Last sample to print (last in file)\n\n"
+"Prints one line per sample: t e0 e1 e2 e3 wx wy wz\n"
+"Euler parameters are stored up to sign, so e may come back as -e of the\n"
+"integrated value, which is the same orientation.\n\n",
+             argv[0]);
+      exit(0);
+
+    case 'f': from = atol(optarg); break;
+    case 't': to = atol(optarg); break;
+    default: abort();
+    } // switch(c)
+  } // while
+
+  if (optind >= argc) {
+    fprintf(stderr, "%s: no input file\n", argv[0]);
+    return 1;
+  }
+  FILE * fp = fopen(argv[optind], "rb");
+  if (!fp) {
+    fprintf(stderr, "could not open %s\n", argv[optind]);
+    return 1;
+  }
+  TrajectoryReader reader;
+  const int status = reader.open(fp);
+  if (status != Success) {
+    if (status == Invalid)
+      fprintf(stderr, "%s is not a valid trajectory\n", argv[optind]);
+    else
+      fprintf(stderr, "could not read %s\n", argv[optind]);
+    fclose(fp);
+    return 1;
+  }
+  if (to < 0 || to >= (long) reader.samples())
+    to = (long) reader.samples() - 1;
+  if (from < 0)
+    from = 0;
+
+  std::vector<State> block(reader.blockSize());
+  std::size_t n;
+  for (long k = from; k <= to; ) {
+    const std::size_t b = k / reader.blockSize();
+    const int s = reader.readBlock(b, block.data(), n);
+    if (s != Success) {
+      fprintf(stderr, s == Invalid ? "corrupt block %zu\n" : "could not read block %zu\n", b);
+      fclose(fp);
+      return 1;
+    }
+    for (std::size_t j = k - b * reader.blockSize(); j < n && k <= to; ++j, ++k) {
+      const State & x = block[j];
+      printf("%.6f %.16e %.16e %.16e %.16e %.16e %.16e %.16e\n",
+             reader.time(k), x[0], x[1], x[2], x[3], x[4], x[5], x[6]);
+    }
+  }
+  fclose(fp);
+  return 0;
+}